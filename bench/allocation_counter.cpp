@@ -0,0 +1,26 @@
+#include "allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// The replacement only adds a relaxed increment in front of malloc. It is
+// kept out of line so GCC does not pair the inlined free with a builtin new.
+#ifdef __GNUC__
+#define ALLOCATOR_NOINLINE __attribute__((noinline))
+#else
+#define ALLOCATOR_NOINLINE
+#endif
+atomic<size_t> heapAllocations(0);
+
+ALLOCATOR_NOINLINE void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    void* block = malloc(size == 0 ? 1 : size);
+    if (block == nullptr) throw bad_alloc();
+    return block;
+}
+
+ALLOCATOR_NOINLINE void operator delete(void* block) noexcept {
+    free(block);
+}
@@ -0,0 +1,13 @@
+// A counting replacement for the global operator new, for the allocation
+// benchmarks. It is linked only into the bench target, so the shipped program
+// and its worker threads do not share the counter.
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+
+// Calls to operator new since startup
+extern std::atomic<std::size_t> heapAllocations;
+
+#endif
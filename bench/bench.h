@@ -0,0 +1,15 @@
+// Entry points of the bench target, dispatched by bench_main.cpp
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+
+// Runs one console suite by name, or every suite for "all"; false for an
+// unknown name (suites.cpp)
+bool runBenchmarks(const std::string& suite);
+
+// The Google Benchmark suite, given the command line (engine_bench.cpp; only
+// built when the library is found)
+int runEngineBenchmarks(int argc, char** argv);
+
+#endif
@@ -0,0 +1,21 @@
+// ./bench --suite <name> runs one of the console suites, ./bench --suite all
+// runs every one of them. Any other command line goes to the Google Benchmark
+// suite, which is only compiled in when the library was found.
+#include "bench.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "--suite") {
+        return runBenchmarks(argc > 2 ? argv[2] : "all") ? 0 : 1;
+    }
+#ifdef ECOMMERCE_GOOGLE_BENCHMARK
+    return runEngineBenchmarks(argc, argv);
+#else
+    cerr << "Google Benchmark was not found when this target was built; use --suite <name>" << endl;
+    return 1;
+#endif
+}
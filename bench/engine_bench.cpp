@@ -0,0 +1,388 @@
+// Google Benchmark suite over the catalog engine (the bench target). The
+// catalog-sized benchmarks run on generated catalogs of 1K to 1M products and
+// fit their times to the complexity the documentation claims; the fit is
+// printed as the _BigO and _RMS rows after each family.
+//
+//   ./bench                                         every benchmark
+//   ./bench --benchmark_filter=Filter               only names matching a regex
+//   ./bench --catalog_distribution=skewed --catalog_seed=5
+//
+// ./bench --suite <name> runs the console suites in suites.cpp instead.
+//
+// The console screens (searchByName, filterByCategory, sortByPrice, ...) print
+// their results, so each is measured through the engine call behind it.
+#include "bench.h"
+#include "ecommerce.h"
+#include "catalog_generator.h"
+#include <benchmark/benchmark.h>
+
+using namespace std;
+
+// Catalog sizes: 1K, 8K, 64K, 512K and 1M products
+const int64_t MIN_CATALOG = 1 << 10;
+const int64_t MAX_CATALOG = 1 << 20;
+const int CATALOG_MULTIPLIER = 8;
+
+// Registers the catalog sizes above. Range() would step through powers of the
+// multiplier (4K, 32K, 256K) rather than multiples of MIN_CATALOG.
+void catalogSizes(benchmark::internal::Benchmark* b) {
+    for (int64_t size = MIN_CATALOG; size < MAX_CATALOG; size *= CATALOG_MULTIPLIER) {
+        b->Arg(size);
+    }
+    b->Arg(MAX_CATALOG);
+}
+
+// Cart sizes: 16 to 4096 lines
+const int64_t MIN_CART = 16;
+const int64_t MAX_CART = 4096;
+
+// Lookups cycle through this many random IDs (a power of two)
+const size_t LOOKUP_KEYS = 4096;
+
+const char BENCH_CATALOG_FILE[] = "engine_bench_catalog.dat";
+
+CatalogDistribution benchDistribution = DISTRIBUTION_UNIFORM;
+unsigned benchSeed = 7;
+int64_t loadedCatalogSize = -1;
+
+// Makes the live catalog a generated one of the given size. Benchmarks of
+// one size share it, so it is only generated again when the size changes.
+void useCatalog(int64_t size) {
+    if (size == loadedCatalogSize) return;
+    int count = static_cast<int>(size);
+    loadGeneratedCatalog(benchDistribution == DISTRIBUTION_SKEWED ? skewedCatalogSpec(count, benchSeed)
+                                                                  : defaultCatalogSpec(count, benchSeed));
+    loadedCatalogSize = size;
+}
+
+vector<int> randomIDs(int64_t size) {
+    mt19937 rng(benchSeed);
+    vector<int> ids(LOOKUP_KEYS);
+    for (int& id : ids) {
+        id = 1 + static_cast<int>(rng() % size);
+    }
+    return ids;
+}
+
+// A cart of lines for products 1..lines, each priced at $1
+void fillCart(Cart& target, int64_t lines) {
+    for (int id = 1; id <= lines; ++id) {
+        addCartLine(target, id, id - 1, 1.0f, 1);
+    }
+}
+
+// ---- BST and binary search ----
+
+// Builds a tree of n increasing IDs, the order new products arrive in
+void BM_InsertNode(benchmark::State& state) {
+    int n = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        Node* tree = nullptr;
+        for (int id = 1; id <= n; ++id) {
+            tree = insertNode(tree, id, id - 1);
+        }
+        benchmark::DoNotOptimize(tree);
+        state.PauseTiming();
+        destroyTree(tree);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+    state.SetComplexityN(n);
+}
+BENCHMARK(BM_InsertNode)->Apply(catalogSizes)
+    ->Complexity(benchmark::oNLogN)->Unit(benchmark::kMillisecond);
+
+void BM_SearchNode(benchmark::State& state) {
+    useCatalog(state.range(0));
+    vector<int> ids = randomIDs(state.range(0));
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(searchNode(root, ids[next]));
+        next = (next + 1) & (LOOKUP_KEYS - 1);
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_SearchNode)->Apply(catalogSizes)
+    ->Complexity(benchmark::oLogN);
+
+void BM_BinarySearchByID(benchmark::State& state) {
+    useCatalog(state.range(0));
+    vector<int> ids = randomIDs(state.range(0));
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(binarySearchByID(idView, ids[next]));
+        next = (next + 1) & (LOOKUP_KEYS - 1);
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_BinarySearchByID)->Apply(catalogSizes)
+    ->Complexity(benchmark::oLogN);
+
+// addProducts and deleteProduct: the tree, every sorted view and the name
+// and category indexes are updated
+void BM_AddRemoveProduct(benchmark::State& state) {
+    useCatalog(state.range(0));
+    Product product = {static_cast<int>(state.range(0)) + 1, "Benchmark Widget", internCategory("Office"),
+                       499.5f, 3.5f};
+    for (auto _ : state) {
+        addProduct(product);
+        removeProduct(product.id);
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_AddRemoveProduct)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+
+// ---- searchByName: substring, word and typo-tolerant matching ----
+
+void BM_SearchByNameSubstring(benchmark::State& state) {
+    useCatalog(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(substringSearchNames("port"));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_SearchByNameSubstring)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+
+void BM_SearchByNameWords(benchmark::State& state) {
+    useCatalog(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(searchNameIndex("wireless mouse"));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_SearchByNameWords)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+
+void BM_SearchByNameFuzzy(benchmark::State& state) {
+    useCatalog(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fuzzySearchNames("wirless", 2));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_SearchByNameFuzzy)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+
+// ---- Filters: every match, as the filter screens list them ----
+
+void BM_Filter(benchmark::State& state, ProductQuery query) {
+    useCatalog(state.range(0));
+    size_t matches = 0;
+    for (auto _ : state) {
+        vector<int> slots = runQuery(query);
+        matches = slots.size();
+        benchmark::DoNotOptimize(slots.data());
+    }
+    state.counters["matches"] = static_cast<double>(matches);
+    state.SetComplexityN(state.range(0));
+}
+
+ProductQuery categoryQuery() {
+    ProductQuery query;
+    query.category = "Kitchen";
+    return query;
+}
+
+ProductQuery priceQuery() {
+    ProductQuery query;
+    query.hasPriceRange = true;
+    query.minPrice = 100.0f;
+    query.maxPrice = 200.0f;
+    return query;
+}
+
+ProductQuery ratingQuery() {
+    ProductQuery query;
+    query.hasRatingRange = true;
+    query.minRating = 4.5f;
+    query.maxRating = 5.0f;
+    return query;
+}
+
+// The combined query screen: all three filters, one page by price
+ProductQuery combinedPageQuery() {
+    ProductQuery query = categoryQuery();
+    query.hasPriceRange = true;
+    query.minPrice = 100.0f;
+    query.maxPrice = 600.0f;
+    query.hasRatingRange = true;
+    query.minRating = 3.0f;
+    query.maxRating = 5.0f;
+    query.sortKey = SORT_BY_PRICE;
+    query.limit = PAGE_SIZE;
+    return query;
+}
+
+BENCHMARK_CAPTURE(BM_Filter, category, categoryQuery())->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Filter, price_range, priceQuery())->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Filter, rating_range, ratingQuery())->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Filter, combined_page, combinedPageQuery())->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+
+// ---- Sorts ----
+
+// sortByPrice, sortByRating and sortByName: one page read from the
+// maintained view, in descending order
+void BM_SortPage(benchmark::State& state, SortKey key) {
+    useCatalog(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sortedPage(key, false, 0, PAGE_SIZE));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK_CAPTURE(BM_SortPage, price, SORT_BY_PRICE)->Apply(catalogSizes)->Complexity(benchmark::o1);
+BENCHMARK_CAPTURE(BM_SortPage, rating, SORT_BY_RATING)->Apply(catalogSizes)->Complexity(benchmark::o1);
+BENCHMARK_CAPTURE(BM_SortPage, name, SORT_BY_NAME)->Apply(catalogSizes)->Complexity(benchmark::o1);
+
+// A category's products in key order, first page only (top-k selection)
+void BM_SortFiltered(benchmark::State& state, SortKey key) {
+    useCatalog(state.range(0));
+    ProductQuery query = categoryQuery();
+    query.sortKey = key;
+    query.ascending = false;
+    query.limit = PAGE_SIZE;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(runQuery(query));
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK_CAPTURE(BM_SortFiltered, price, SORT_BY_PRICE)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_SortFiltered, rating, SORT_BY_RATING)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_SortFiltered, name, SORT_BY_NAME)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMicrosecond);
+
+// Full re-sort of the price, rating and name views, as after a bulk load
+void BM_RebuildSortedViews(benchmark::State& state) {
+    useCatalog(state.range(0));
+    for (auto _ : state) {
+        rebuildSortedViews();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_RebuildSortedViews)->Apply(catalogSizes)
+    ->Complexity(benchmark::oNLogN)->Unit(benchmark::kMillisecond);
+
+// ---- Cart: the hash-indexed line list behind addToCart and setCartQuantity ----
+
+// Fills a recycled cart with n new lines
+void BM_CartAdd(benchmark::State& state) {
+    Cart target = {{}, {}, 0.0, 0};
+    for (auto _ : state) {
+        fillCart(target, state.range(0));
+        resetCart(target);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_CartAdd)->RangeMultiplier(4)->Range(MIN_CART, MAX_CART)->Complexity(benchmark::oN);
+
+void BM_CartSetQuantity(benchmark::State& state) {
+    Cart target = {{}, {}, 0.0, 0};
+    fillCart(target, state.range(0));
+    vector<int> ids = randomIDs(state.range(0));
+    size_t next = 0;
+    int quantity = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(setCartLineQuantity(target, ids[next], quantity));
+        next = (next + 1) & (LOOKUP_KEYS - 1);
+        quantity = quantity % 9 + 1;
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_CartSetQuantity)->RangeMultiplier(4)->Range(MIN_CART, MAX_CART)->Complexity(benchmark::o1);
+
+// Removes every line of an n-line cart, in the order they were added
+void BM_CartRemove(benchmark::State& state) {
+    Cart target = {{}, {}, 0.0, 0};
+    for (auto _ : state) {
+        state.PauseTiming();
+        fillCart(target, state.range(0));
+        state.ResumeTiming();
+        for (int id = 1; id <= state.range(0); ++id) {
+            setCartLineQuantity(target, id, 0);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_CartRemove)->RangeMultiplier(4)->Range(MIN_CART, MAX_CART)->Complexity(benchmark::oN);
+
+// ---- Save and load of products.dat ----
+
+void BM_SaveCatalog(benchmark::State& state) {
+    useCatalog(state.range(0));
+    for (auto _ : state) {
+        if (!saveProductsToFile(BENCH_CATALOG_FILE)) {
+            state.SkipWithError("could not write the catalog file");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_SaveCatalog)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMillisecond);
+
+void BM_LoadCatalog(benchmark::State& state) {
+    useCatalog(state.range(0));
+    if (!saveProductsToFile(BENCH_CATALOG_FILE)) {
+        state.SkipWithError("could not write the catalog file");
+        return;
+    }
+    for (auto _ : state) {
+        loadProductsFromFile(BENCH_CATALOG_FILE);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_LoadCatalog)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMillisecond);
+
+// ---- The generator itself ----
+
+void BM_GenerateCatalog(benchmark::State& state) {
+    int count = static_cast<int>(state.range(0));
+    CatalogSpec spec = benchDistribution == DISTRIBUTION_SKEWED ? skewedCatalogSpec(count, benchSeed)
+                                                                 : defaultCatalogSpec(count, benchSeed);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(generateCatalog(spec));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetComplexityN(count);
+}
+BENCHMARK(BM_GenerateCatalog)->Apply(catalogSizes)
+    ->Complexity(benchmark::oN)->Unit(benchmark::kMillisecond);
+
+// Google Benchmark takes its own --benchmark_* flags out of argv; the rest
+// choose the catalog the benchmarks run on
+int runEngineBenchmarks(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    const string distributionFlag = "--catalog_distribution=";
+    const string seedFlag = "--catalog_seed=";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.compare(0, distributionFlag.size(), distributionFlag) == 0 &&
+            parseCatalogDistribution(arg.substr(distributionFlag.size()), benchDistribution)) {
+            continue;
+        }
+        if (arg.compare(0, seedFlag.size(), seedFlag) == 0) {
+            benchSeed = static_cast<unsigned>(strtoul(arg.c_str() + seedFlag.size(), nullptr, 10));
+            continue;
+        }
+        cerr << "Error: Unknown argument " << arg
+             << " (expected --catalog_distribution=uniform|skewed or --catalog_seed=N)" << endl;
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    remove(BENCH_CATALOG_FILE);
+    return 0;
+}
@@ -0,0 +1,1420 @@
+// The console benchmark suites (./bench --suite <name>): each times one engine
+// path on synthetic catalogs of up to 1M products against the approach it
+// replaced, and prints a table. Allocation counts come from the counting
+// operator new in allocation_counter.cpp, which is linked into this target.
+#include "bench.h"
+#include "allocation_counter.h"
+#include "ecommerce.h"
+#include "catalog_generator.h"
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Function prototypes
+void benchIndexLookup();
+void benchRangeFilter();
+void benchNameSearch();
+void benchSubstringSearch();
+void benchCategoryFilter();
+void benchQueryEngine();
+void benchTopK();
+void benchCatalogLoad();
+void benchBulkLoad();
+void benchMutationLog();
+void benchImport();
+void benchExport();
+void benchColumnScan();
+void benchFilterKernels();
+void benchAllocations();
+void benchSnapshotReads();
+void benchCart();
+void benchCartSessions();
+void benchBatch();
+void benchServer();
+long memoryStatusKB(const char* field, bool resetPeak);
+
+bool runBenchmarks(const string& suite) {
+    bool known = false;
+    if (suite == "all" || suite == "index") {
+        benchIndexLookup();
+        known = true;
+    }
+    if (suite == "all" || suite == "filter") {
+        benchRangeFilter();
+        known = true;
+    }
+    if (suite == "all" || suite == "category") {
+        benchCategoryFilter();
+        known = true;
+    }
+    if (suite == "all" || suite == "query") {
+        benchQueryEngine();
+        known = true;
+    }
+    if (suite == "all" || suite == "topk") {
+        benchTopK();
+        known = true;
+    }
+    if (suite == "all" || suite == "load") {
+        benchCatalogLoad();
+        known = true;
+    }
+    if (suite == "all" || suite == "bulk") {
+        benchBulkLoad();
+        known = true;
+    }
+    if (suite == "all" || suite == "wal") {
+        benchMutationLog();
+        known = true;
+    }
+    if (suite == "all" || suite == "import") {
+        benchImport();
+        known = true;
+    }
+    if (suite == "all" || suite == "export") {
+        benchExport();
+        known = true;
+    }
+    if (suite == "all" || suite == "columns") {
+        benchColumnScan();
+        known = true;
+    }
+    if (suite == "all" || suite == "simd") {
+        benchFilterKernels();
+        known = true;
+    }
+    if (suite == "all" || suite == "alloc") {
+        benchAllocations();
+        known = true;
+    }
+    if (suite == "all" || suite == "reads") {
+        benchSnapshotReads();
+        known = true;
+    }
+    if (suite == "all" || suite == "cart") {
+        benchCart();
+        known = true;
+    }
+    if (suite == "all" || suite == "sessions") {
+        benchCartSessions();
+        known = true;
+    }
+    if (suite == "all" || suite == "batch") {
+        benchBatch();
+        known = true;
+    }
+    if (suite == "all" || suite == "server") {
+        benchServer();
+        known = true;
+    }
+    if (suite == "all" || suite == "name") {
+        benchNameSearch();
+        benchSubstringSearch();
+        known = true;
+    }
+    if (!known) {
+        cerr << "Unknown benchmark suite: " << suite << endl;
+    }
+    return known;
+}
+
+// Builds the index from sequential IDs (the worst case for an unbalanced BST)
+// and measures random lookup latency at several catalog sizes.
+void benchIndexLookup() {
+    const int sizes[] = {10000, 100000, 1000000};
+    const int lookups = 1000000;
+    mt19937 rng(42);
+
+    cout << "=== INDEX LOOKUP BENCHMARK ===" << endl;
+    for (int n : sizes) {
+        Node* tree = nullptr;
+        auto start = chrono::steady_clock::now();
+        for (int i = 1; i <= n; ++i) {
+            tree = insertNode(tree, i, i - 1);
+        }
+        double insertMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        uniform_int_distribution<int> pick(1, n);
+        vector<int> probes;
+        probes.reserve(lookups);
+        for (int i = 0; i < lookups; ++i) {
+            probes.push_back(pick(rng));
+        }
+
+        int hits = 0;
+        start = chrono::steady_clock::now();
+        for (int id : probes) {
+            if (searchNode(tree, id) != nullptr) hits++;
+        }
+        double lookupNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / lookups;
+
+        cout << setw(8) << n << " products | height " << setw(2) << nodeHeight(tree)
+             << " | build " << fixed << setprecision(1) << setw(8) << insertMs << " ms"
+             << " | lookup " << setw(7) << lookupNs << " ns/op"
+             << " | hits " << hits << endl;
+        cout.unsetf(ios::fixed);
+        destroyTree(tree);
+    }
+}
+
+// Compares the old full scan against the price range index on a 1M catalog
+void benchRangeFilter() {
+    const int n = 1000000;
+    const int queries = 200;
+    mt19937 rng(7);
+    uniform_real_distribution<float> priceDist(0.0f, 1000.0f);
+    loadSyntheticCatalog(n, 7);
+    vector<Product> rows = copyProducts();
+
+    cout << "=== PRICE RANGE FILTER BENCHMARK (" << n << " products) ===" << endl;
+    const float widths[] = {1.0f, 10.0f, 100.0f};
+    for (float width : widths) {
+        vector<float> lows;
+        for (int q = 0; q < queries; ++q) {
+            lows.push_back(priceDist(rng) * (1000.0f - width) / 1000.0f);
+        }
+
+        long scanHits = 0;
+        auto start = chrono::steady_clock::now();
+        for (float low : lows) {
+            for (const Product& product : rows) {
+                if (product.price >= low && product.price <= low + width) scanHits++;
+            }
+        }
+        double scanUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / queries;
+
+        long indexHits = 0;
+        start = chrono::steady_clock::now();
+        for (float low : lows) {
+            pair<int, int> range = viewRange(SORT_BY_PRICE, low, low + width);
+            for (int i = range.first; i < range.second; ++i) {
+                if (columns.id[sortedViews[SORT_BY_PRICE][i]] > 0) indexHits++;
+            }
+        }
+        double indexUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / queries;
+
+        cout << "range width $" << setw(4) << static_cast<int>(width)
+             << " | avg matches " << setw(7) << indexHits / queries
+             << " | full scan " << fixed << setprecision(1) << setw(9) << scanUs << " us"
+             << " | range index " << setw(8) << indexUs << " us"
+             << (scanHits == indexHits ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Compares the old substring scan against the inverted name index
+void benchNameSearch() {
+    const int n = 1000000;
+    const char* queries[] = {"mouse", "wireless mou", "smart watch", "deluxe tent slim", "ergo"};
+    loadSyntheticCatalog(n, 11);
+    vector<Product> rows = copyProducts();
+
+    cout << "=== NAME SEARCH BENCHMARK (" << n << " products) ===" << endl;
+    for (const char* query : queries) {
+        // Case-insensitive scan with the same word-prefix semantics, for a fair baseline
+        vector<string> words = tokenizeName(query);
+        auto start = chrono::steady_clock::now();
+        long scanHits = 0;
+        for (const Product& product : rows) {
+            vector<string> tokens = tokenizeName(product.name);
+            bool all = true;
+            for (const string& word : words) {
+                bool any = false;
+                for (const string& token : tokens) {
+                    if (token.compare(0, word.size(), word) == 0) { any = true; break; }
+                }
+                if (!any) { all = false; break; }
+            }
+            if (all) scanHits++;
+        }
+        double scanMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        // The original case-sensitive string::find scan, for reference
+        start = chrono::steady_clock::now();
+        long findHits = 0;
+        for (const Product& product : rows) {
+            if (product.name.find(query) != string::npos) findHits++;
+        }
+        double findMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        const int repeats = 20;
+        size_t indexHits = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            indexHits = searchNameIndex(query).size();
+        }
+        double indexMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+        cout << "\"" << query << "\"" << string(18 - strlen(query), ' ')
+             << "| matches " << setw(7) << indexHits
+             << " | find() " << fixed << setprecision(2) << setw(7) << findMs << " ms"
+             << " | token scan " << setw(7) << scanMs << " ms"
+             << " | index " << setw(7) << indexMs << " ms"
+             << (static_cast<size_t>(scanHits) == indexHits ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Compares a full case-insensitive substring scan against the trigram index,
+// and times the fuzzy mode on misspelled queries
+void benchSubstringSearch() {
+    const int n = 1000000;
+    const char* queries[] = {"less mou", "phones", "ger", "keyboard vint", "blend"};
+    const char* typos[] = {"wireles mose", "hedphones", "kettel", "backpak slim"};
+    loadSyntheticCatalog(n, 13);
+    vector<Product> rows = copyProducts();
+
+    cout << "=== SUBSTRING / FUZZY NAME SEARCH BENCHMARK (" << n << " products) ===" << endl;
+    for (const char* query : queries) {
+        string needle = query;
+        auto start = chrono::steady_clock::now();
+        long scanHits = 0;
+        for (const Product& product : rows) {
+            if (containsIgnoreCase(product.name, needle)) scanHits++;
+        }
+        double scanMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        const int repeats = 10;
+        size_t indexHits = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            indexHits = substringSearchNames(query).size();
+        }
+        double indexMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+        cout << "substring \"" << query << "\"" << string(16 - strlen(query), ' ')
+             << "| matches " << setw(7) << indexHits
+             << " | scan " << fixed << setprecision(2) << setw(7) << scanMs << " ms"
+             << " | trigram index " << setw(7) << indexMs << " ms"
+             << (static_cast<size_t>(scanHits) == indexHits ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    }
+
+    for (const char* query : typos) {
+        const int repeats = 10;
+        size_t hits = 0;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            hits = fuzzySearchNames(query, 2).size();
+        }
+        double fuzzyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+        cout << "fuzzy     \"" << query << "\"" << string(16 - strlen(query), ' ')
+             << "| matches " << setw(7) << hits
+             << " | fuzzy " << fixed << setprecision(2) << setw(7) << fuzzyMs << " ms" << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Compares the old per-product string comparison with the category posting lists
+void benchCategoryFilter() {
+    const int n = 1000000;
+    const char* queries[] = {"Electronics", "Kitchen", "Office"};
+    loadSyntheticCatalog(n, 17);
+    vector<Product> rows = copyProducts();
+
+    cout << "=== CATEGORY FILTER BENCHMARK (" << n << " products, "
+         << categoryNames.size() << " categories) ===" << endl;
+    cout << "Product record: " << sizeof(Product) << " bytes; the category is a " << sizeof(int)
+         << "-byte code instead of a " << sizeof(string) << "-byte string plus its text" << endl;
+
+    for (const char* query : queries) {
+        string category = query;
+        auto start = chrono::steady_clock::now();
+        long scanHits = 0;
+        for (const Product& product : rows) {
+            if (categoryName(product.categoryCode) == category) scanHits++;
+        }
+        double scanMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        const int repeats = 100;
+        long postingHits = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            int code = findCategory(category);
+            postingHits = 0;
+            for (int slot : categoryPostings[code]) {
+                postingHits += columns.id[slot] > 0;
+            }
+        }
+        double postingMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+        cout << "\"" << query << "\"" << string(14 - strlen(query), ' ')
+             << "| matches " << setw(7) << postingHits
+             << " | string scan " << fixed << setprecision(2) << setw(7) << scanMs << " ms"
+             << " | posting list " << setw(6) << postingMs << " ms"
+             << (scanHits == postingHits ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Runs combined queries through runQuery and through a single pass that
+// checks every predicate on every product
+void benchQueryEngine() {
+    const int n = 1000000;
+    loadSyntheticCatalog(n, 19);
+
+    ProductQuery queries[4];
+    queries[0].category = "Electronics";
+    queries[0].hasPriceRange = true;
+    queries[0].minPrice = 100.0f;
+    queries[0].maxPrice = 300.0f;
+    queries[0].hasRatingRange = true;
+    queries[0].minRating = 4.0f;
+    queries[0].maxRating = 5.0f;
+    queries[0].nameContains = "wireless";
+    queries[1] = queries[0];
+    queries[1].nameContains = "";
+    queries[1].sortKey = SORT_BY_PRICE;
+    queries[2].nameContains = "headphones slim";
+    queries[2].hasPriceRange = true;
+    queries[2].minPrice = 500.0f;
+    queries[2].maxPrice = 505.0f;
+    queries[3].category = "Office";
+    queries[3].hasRatingRange = true;
+    queries[3].minRating = 5.0f;
+    queries[3].maxRating = 5.0f;
+    queries[3].sortKey = SORT_BY_RATING;
+    queries[3].ascending = false;
+    const char* labels[] = {"cat+price+rating+name", "cat+price+rating", "name+narrow price", "cat+rating=5"};
+
+    cout << "=== COMBINED QUERY BENCHMARK (" << n << " products) ===" << endl;
+    for (int q = 0; q < 4; ++q) {
+        const ProductQuery& query = queries[q];
+        string needle = query.nameContains;
+        transform(needle.begin(), needle.end(), needle.begin(), ::tolower);
+        int code = query.category.empty() ? -1 : findCategory(query.category);
+
+        auto start = chrono::steady_clock::now();
+        long scanHits = 0;
+        for (int slot : idView) {
+            Product product = productAt(slot);
+            if (code >= 0 && product.categoryCode != code) continue;
+            if (query.hasPriceRange && (product.price < query.minPrice || product.price > query.maxPrice)) continue;
+            if (query.hasRatingRange && (product.rating < query.minRating || product.rating > query.maxRating)) continue;
+            if (!needle.empty() && !containsIgnoreCase(product.name, needle)) continue;
+            scanHits++;
+        }
+        double scanMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        const int repeats = 10;
+        size_t hits = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            hits = runQuery(query).size();
+        }
+        double queryMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+
+        cout << left << setw(22) << labels[q] << right
+             << "| matches " << setw(6) << hits
+             << " | full scan " << fixed << setprecision(2) << setw(7) << scanMs << " ms"
+             << " | runQuery " << setw(6) << queryMs << " ms"
+             << (static_cast<size_t>(scanHits) == hits ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Page 1 of "highest rated": the original full sort of Product copies, a
+// read of the pre-built rating view, and partial selection over a query result
+void benchTopK() {
+    const int n = 1000000;
+    const size_t k = PAGE_SIZE;
+    loadSyntheticCatalog(n, 23);
+    cout << "=== TOP-K BENCHMARK (" << n << " products, K = " << k << ") ===" << endl;
+
+    vector<Product> copies = copyProducts();
+    auto start = chrono::steady_clock::now();
+    sort(copies.begin(), copies.end(),
+        [](const Product& a, const Product& b) { return keyLess(SORT_BY_RATING, b, a); });
+    double fullSortMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    const int repeats = 1000;
+    vector<int> page;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        page = sortedPage(SORT_BY_RATING, false, 0, k);
+    }
+    double viewUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / repeats;
+    bool same = columns.id[page[0]] == copies[0].id;
+
+    cout << "full std::sort of Products       | " << fixed << setprecision(2) << setw(9) << fullSortMs << " ms" << endl;
+    cout << "page 1 from the rating view      | " << setw(9) << viewUs << " us"
+         << (same ? "" : " | MISMATCH") << endl;
+
+    // A query whose driver is not the sort key still needs ordering
+    ProductQuery query;
+    query.category = "Kitchen";
+    query.sortKey = SORT_BY_RATING;
+    query.ascending = false;
+    for (size_t limit : {size_t(0), k}) {
+        query.limit = limit;
+        const int queryRepeats = 10;
+        size_t hits = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < queryRepeats; ++r) {
+            hits = runQuery(query).size();
+        }
+        double queryMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / queryRepeats;
+        cout << (limit == 0 ? "Kitchen by rating, full sort     | " : "Kitchen by rating, top K         | ")
+             << setw(9) << queryMs << " ms | results " << hits << endl;
+    }
+    cout.unsetf(ios::fixed);
+}
+
+// Saves and reloads a 1M-product catalog in the legacy layout and in the
+// version 2 catalog format
+void benchCatalogLoad() {
+    const int n = 1000000;
+    const char* legacyFile = "bench_legacy.dat";
+    const char* catalogFile = "bench_catalog.dat";
+    loadSyntheticCatalog(n, 29);
+    int lastID = columns.id[idView.back()];
+    cout << "=== CATALOG LOAD BENCHMARK (" << n << " products) ===" << endl;
+
+    auto start = chrono::steady_clock::now();
+    saveLegacyProductsToFile(legacyFile);
+    double legacySaveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    saveProductsToFile(catalogFile);
+    double catalogSaveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    loadProductsFromFile(legacyFile);
+    double legacyLoadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    bool legacyOK = idView.size() == static_cast<size_t>(n) && columns.id[idView.back()] == lastID;
+
+    start = chrono::steady_clock::now();
+    loadProductsFromFile(catalogFile);
+    double catalogLoadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    bool catalogOK = idView.size() == static_cast<size_t>(n) && columns.id[idView.back()] == lastID;
+
+    auto fileSize = [](const char* name) {
+        ifstream in(name, ios::binary | ios::ate);
+        return static_cast<double>(in.tellg()) / (1024.0 * 1024.0);
+    };
+    cout << fixed << setprecision(1);
+    cout << "legacy v1  | " << setw(6) << fileSize(legacyFile) << " MB | save " << setw(7) << legacySaveMs
+         << " ms | load " << setw(7) << legacyLoadMs << " ms" << (legacyOK ? "" : " | MISMATCH") << endl;
+    cout << "catalog v2 | " << setw(6) << fileSize(catalogFile) << " MB | save " << setw(7) << catalogSaveMs
+         << " ms | load " << setw(7) << catalogLoadMs << " ms" << (catalogOK ? "" : " | MISMATCH") << endl;
+    cout.unsetf(ios::fixed);
+
+    remove(legacyFile);
+    remove(catalogFile);
+}
+
+// Index construction for 1M records: one insertNode per product against the
+// O(n) build from sorted slots, then the whole bulk load from sorted and
+// shuffled input
+void benchBulkLoad() {
+    const int n = 1000000;
+    loadSyntheticCatalog(n, 31);
+    vector<Product> sortedInput = copyProducts();
+    vector<int> slots(idView.begin(), idView.end());
+    cout << "=== BULK LOAD BENCHMARK (" << n << " records) ===" << endl;
+
+    auto start = chrono::steady_clock::now();
+    Node* incremental = nullptr;
+    for (int slot : slots) {
+        incremental = insertNode(incremental, columns.id[slot], slot);
+    }
+    double insertMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    int insertHeight = nodeHeight(incremental);
+    destroyTree(incremental);
+
+    start = chrono::steady_clock::now();
+    Node* bulk = buildTreeFromSorted(slots, 0, slots.size());
+    double buildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    int buildHeight = nodeHeight(bulk);
+    destroyTree(bulk);
+
+    cout << fixed << setprecision(1);
+    cout << "tree: insertNode x n        | " << setw(8) << insertMs << " ms | height " << insertHeight << endl;
+    cout << "tree: buildTreeFromSorted   | " << setw(8) << buildMs << " ms | height " << buildHeight << endl;
+
+    vector<Product> shuffledInput = sortedInput;
+    shuffle(shuffledInput.begin(), shuffledInput.end(), mt19937(37));
+    vector<Product>* inputs[] = {&sortedInput, &shuffledInput};
+    const char* labels[] = {"bulkLoadProducts (sorted)   | ", "bulkLoadProducts (shuffled) | "};
+    for (int i = 0; i < 2; ++i) {
+        start = chrono::steady_clock::now();
+        bulkLoadProducts(*inputs[i]);
+        double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << labels[i] << setw(8) << loadMs << " ms | products " << idView.size()
+             << " | height " << nodeHeight(root) << endl;
+    }
+    cout.unsetf(ios::fixed);
+}
+
+// Cost of making changes durable on a 1M-product catalog: rewriting the whole
+// snapshot (what every save did before the log) against appending a batch of
+// updates to the log with one fsync, then the time to replay the log
+void benchMutationLog() {
+    const int n = 1000000;
+    const char* catalogFile = "bench_wal.dat";
+    loadSyntheticCatalog(n, 41);
+    cout << "=== MUTATION LOG BENCHMARK (" << n << " products) ===" << endl;
+
+    auto start = chrono::steady_clock::now();
+    saveProductsToFile(catalogFile);
+    double snapshotMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << fixed << setprecision(1);
+    cout << "full snapshot rewrite      | " << setw(9) << snapshotMs << " ms" << endl;
+
+    remove((string(catalogFile) + ".wal").c_str());
+    openMutationLog(catalogFile);
+    mt19937 rng(43);
+    uniform_int_distribution<int> pick(0, n - 1);
+    const int repeats = 10;
+    size_t logged = 0;
+    cout << setprecision(3);
+    for (int batch : {1, 10, 100, 1000}) {
+        double flushMs = 0.0;
+        for (int r = 0; r < repeats; ++r) {
+            for (int i = 0; i < batch; ++i) {
+                Product p = productAt(idView[pick(rng)]);
+                p.price += 1.0f;
+                updateProduct(p);
+            }
+            start = chrono::steady_clock::now();
+            flushMutationLog();
+            flushMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+        flushMs /= repeats;
+        logged += static_cast<size_t>(batch) * repeats;
+        cout << "log batch of " << setw(4) << batch << " + fsync   | " << setw(9) << flushMs << " ms | "
+             << setw(7) << flushMs * 1000.0 / batch << " us/record" << endl;
+    }
+    uint64_t logBytes = mutationLog.size;
+    closeMutationLog();
+    int probeID = columns.id[idView[n / 2]];
+    float expectedPrice = columns.price[searchNode(root, probeID)->slot];
+
+    start = chrono::steady_clock::now();
+    loadProductsFromFile(catalogFile);
+    double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    size_t replayed = replayMutationLog(string(catalogFile) + ".wal");
+    double replayMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    bool same = replayed == logged && columns.price[searchNode(root, probeID)->slot] == expectedPrice;
+
+    cout << setprecision(1);
+    cout << "snapshot load              | " << setw(9) << loadMs << " ms" << endl;
+    cout << "replay " << setw(6) << replayed << " records     | " << setw(9) << replayMs << " ms | "
+         << setw(6) << logBytes / 1024 << " KB log" << (same ? "" : " | MISMATCH") << endl;
+    cout.unsetf(ios::fixed);
+
+    remove(catalogFile);
+    remove((string(catalogFile) + ".wal").c_str());
+}
+
+// Writes a 1M-row feed in both formats and imports each into an empty
+// catalog with one worker thread and with one per hardware thread
+void benchImport() {
+    const int n = 1000000;
+    const char* csvFile = "bench_feed.csv";
+    const char* jsonFile = "bench_feed.jsonl";
+    loadSyntheticCatalog(n, 47);
+    {
+        ofstream csv(csvFile, ios::binary);
+        ofstream json(jsonFile, ios::binary);
+        csv << "name,category,price,rating\n";
+        for (int slot : idView) {
+            Product p = productAt(slot);
+            csv << p.name << ',' << categoryName(p.categoryCode) << ',' << p.price << ',' << p.rating << '\n';
+            json << "{\"name\": \"" << p.name << "\", \"category\": \"" << categoryName(p.categoryCode)
+                 << "\", \"price\": " << p.price << ", \"rating\": " << p.rating << "}\n";
+        }
+    }
+    int hardware = max(2u, thread::hardware_concurrency());
+    cout << "=== FEED IMPORT BENCHMARK (" << n << " rows, " << thread::hardware_concurrency()
+         << " hardware threads) ===" << endl;
+
+    const char* files[] = {csvFile, jsonFile};
+    for (const char* feed : files) {
+        for (int threads : {1, hardware}) {
+            clearCatalog();
+            idAllocator.nextID = 1;
+            ImportStats stats;
+            importProductsFromFile(feed, threads, stats);
+            double totalMs = stats.parseMs + stats.insertMs + stats.saveMs;
+            cout << fixed << setprecision(1);
+            cout << setw(16) << left << feed << right << " | " << setw(2) << threads << " threads | parse "
+                 << setw(7) << stats.parseMs << " ms (" << setw(8) << setprecision(0) << stats.rows * 1000.0 / stats.parseMs
+                 << " rows/s) | total " << setprecision(1) << setw(7) << totalMs << " ms (" << setw(8) << setprecision(0)
+                 << stats.rows * 1000.0 / totalMs << " rows/s)"
+                 << (stats.imported == static_cast<size_t>(n) && idView.size() == static_cast<size_t>(n) ? "" : " | MISMATCH")
+                 << endl;
+            cout.unsetf(ios::fixed);
+        }
+    }
+
+    remove(csvFile);
+    remove(jsonFile);
+}
+
+// Reads a field such as VmRSS or VmHWM from /proc/self/status, in kB. With
+// resetPeak the peak (VmHWM) is first reset to the current RSS. Returns -1
+// where the kernel does not provide these.
+long memoryStatusKB(const char* field, bool resetPeak) {
+#ifdef __linux__
+    if (resetPeak) {
+        ofstream clearRefs("/proc/self/clear_refs");
+        clearRefs << "5";
+    }
+    ifstream status("/proc/self/status");
+    string line;
+    string prefix = string(field) + ":";
+    while (getline(status, line)) {
+        if (line.compare(0, prefix.size(), prefix) == 0) {
+            return atol(line.c_str() + prefix.size());
+        }
+    }
+#else
+    (void)field;
+    (void)resetPeak;
+#endif
+    return -1;
+}
+
+// Time and peak extra memory of the snapshot and CSV exports on a 1M-product
+// catalog, first straight after a load (slots in ID order) and then after
+// removals and adds have reused slots
+void benchExport() {
+    const int n = 1000000;
+    const char* catalogFile = "bench_export.dat";
+    const char* csvFile = "bench_export.csv";
+    loadSyntheticCatalog(n, 53);
+    cout << "=== STREAMING EXPORT BENCHMARK (" << n << " products) ===" << endl;
+
+    auto fileSize = [](const char* name) {
+        ifstream in(name, ios::binary | ios::ate);
+        return static_cast<double>(in.tellg()) / (1024.0 * 1024.0);
+    };
+    auto measure = [&](const char* label, bool (*exporter)(const string&), const char* file) {
+        long before = memoryStatusKB("VmRSS", true);
+        auto start = chrono::steady_clock::now();
+        bool ok = exporter(file);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        long peak = memoryStatusKB("VmHWM", false);
+        cout << fixed << setprecision(1);
+        cout << label << " | " << setw(6) << fileSize(file) << " MB file | " << setw(7) << ms << " ms | extra memory ";
+        if (before >= 0 && peak >= 0) {
+            cout << setw(6) << (peak - before) / 1024.0 << " MB";
+        } else {
+            cout << "   n/a";
+        }
+        cout << (ok ? "" : " | FAILED") << endl;
+        cout.unsetf(ios::fixed);
+    };
+
+    measure("snapshot, fresh load  ", saveProductsToFile, catalogFile);
+    measure("CSV, fresh load       ", exportProductsToCSV, csvFile);
+
+    mt19937 rng(59);
+    for (int i = 0; i < n / 10; ++i) {
+        removeProduct(columns.id[idView[rng() % idView.size()]]);
+    }
+    for (int i = 0; i < n / 20; ++i) {
+        Product p = productAt(idView[rng() % idView.size()]);
+        p.id = generateProductNumber();
+        addProduct(p);
+    }
+    measure("snapshot, reused slots", saveProductsToFile, catalogFile);
+
+    remove(catalogFile);
+    remove(csvFile);
+}
+
+// Runs the same scans and sorts once over the Product rows and once over the
+// columns. Every scan is sequential over a freshly loaded store (the best case
+// for the rows); the sorts follow shuffled slots like the view rebuilds do.
+void benchColumnScan() {
+    const int n = 1000000;
+    const int passes = 20;
+    loadSyntheticCatalog(n, 61);
+    // Freshly loaded, so slot s is also rows[s]
+    vector<Product> rows = copyProducts();
+    int code = findCategory("Kitchen");
+    cout << "=== COLUMN STORE BENCHMARK (" << n << " products, " << sizeof(Product) << "-byte rows) ===" << endl;
+
+    auto timeMs = [](const function<long()>& scan, int repeat, long& result) {
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repeat; ++r) {
+            result = scan();
+        }
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeat;
+    };
+    auto report = [](const char* label, double rowMs, double columnMs, size_t columnBytes, bool same) {
+        cout << fixed << setprecision(2);
+        cout << label << " | rows " << setw(8) << rowMs << " ms | columns " << setw(8) << columnMs << " ms | ";
+        if (columnBytes > 0) {
+            cout << setw(5) << setprecision(1) << columnBytes / (columnMs * 1e6) << " GB/s | ";
+        }
+        cout << setprecision(1) << rowMs / columnMs << "x faster" << (same ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    };
+
+    long rowResult = 0, columnResult = 0;
+    double rowMs = timeMs([&rows] {
+        long hits = 0;
+        for (const Product& product : rows) hits += (product.price >= 250.0f) & (product.price <= 500.0f);
+        return hits;
+    }, passes, rowResult);
+    double columnMs = timeMs([] {
+        long hits = 0;
+        const float* price = columns.price.data();
+        for (size_t slot = 0; slot < columns.price.size(); ++slot) hits += (price[slot] >= 250.0f) & (price[slot] <= 500.0f);
+        return hits;
+    }, passes, columnResult);
+    report("price range count  ", rowMs, columnMs, n * sizeof(float), rowResult == columnResult);
+
+    rowMs = timeMs([&rows] {
+        double sum = 0;
+        for (const Product& product : rows) sum += product.rating;
+        return static_cast<long>(sum * 10);
+    }, passes, rowResult);
+    columnMs = timeMs([] {
+        double sum = 0;
+        for (float rating : columns.rating) sum += rating;
+        return static_cast<long>(sum * 10);
+    }, passes, columnResult);
+    report("rating sum         ", rowMs, columnMs, n * sizeof(float), rowResult == columnResult);
+
+    rowMs = timeMs([&rows, code] {
+        long hits = 0;
+        for (const Product& product : rows) hits += product.categoryCode == code;
+        return hits;
+    }, passes, rowResult);
+    columnMs = timeMs([code] {
+        long hits = 0;
+        for (int c : columns.categoryCode) hits += c == code;
+        return hits;
+    }, passes, columnResult);
+    report("category count     ", rowMs, columnMs, n * sizeof(int), rowResult == columnResult);
+
+    const string needle = "tent";
+    rowMs = timeMs([&rows, &needle] {
+        long hits = 0;
+        for (const Product& product : rows) hits += containsIgnoreCase(product.name, needle);
+        return hits;
+    }, 3, rowResult);
+    columnMs = timeMs([&needle] {
+        long hits = 0;
+        for (size_t slot = 0; slot < columns.id.size(); ++slot) {
+            hits += containsIgnoreCase(columnName(slot), columns.name[slot].length, needle);
+        }
+        return hits;
+    }, 3, columnResult);
+    report("name substring scan", rowMs, columnMs, columns.nameArena.size(), rowResult == columnResult);
+
+    vector<int> shuffled = idView;
+    shuffle(shuffled.begin(), shuffled.end(), mt19937(67));
+    for (int key = SORT_BY_PRICE; key <= SORT_BY_NAME; ++key) {
+        SortKey k = static_cast<SortKey>(key);
+        vector<int> byRows = shuffled, byColumns = shuffled;
+        rowMs = timeMs([&rows, &byRows, k] {
+            sort(byRows.begin(), byRows.end(),
+                [&rows, k](int a, int b) { return keyLess(k, rows[a], rows[b]); });
+            return 0L;
+        }, 1, rowResult);
+        columnMs = timeMs([&byColumns, k] {
+            sort(byColumns.begin(), byColumns.end(), [k](int a, int b) { return slotLess(k, a, b); });
+            return 0L;
+        }, 1, columnResult);
+        const char* label = k == SORT_BY_PRICE ? "sort slots by price " : (k == SORT_BY_RATING ? "sort slots by rating" : "sort slots by name  ");
+        report(label, rowMs, columnMs, 0, byRows == byColumns && byRows == sortedViews[k]);
+    }
+}
+
+// Scans 1M products for a price range, a category, and all three attribute
+// predicates together: once with the per-Product loop the filters used to
+// run, then with every filter kernel set this CPU supports. GB/s counts the
+// column bytes a predicate needs (4 per product per predicate), so the rows
+// loop is charged for the same data even though it streams whole Products.
+void benchFilterKernels() {
+    const int n = 1000000;
+    const int passes = 50;
+    loadSyntheticCatalog(n, 71);
+    vector<Product> rows = copyProducts();
+    const float minPrice = 250.0f, maxPrice = 500.0f, minRating = 4.0f, maxRating = 5.0f;
+    const int code = findCategory("Sports");
+    const size_t count = columns.id.size();
+    const size_t words = (count + 63) / 64;
+    vector<uint64_t> selected(words), mask(words);
+
+    cout << "=== FILTER KERNEL BENCHMARK (" << n << " products, widest: " << activeFilterKernels().name << ") ===" << endl;
+    auto report = [n](const string& label, double ms, int predicates, size_t matches, size_t expected) {
+        cout << left << setw(34) << label << right << fixed << setprecision(3)
+             << "| " << setw(7) << ms << " ms | " << setprecision(1) << setw(5)
+             << n * 4.0 * predicates / (ms * 1e6) << " GB/s | matches " << matches
+             << (matches == expected ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    };
+    auto timeMs = [passes](const function<size_t()>& run, size_t& result) {
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < passes; ++r) {
+            result = run();
+        }
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / passes;
+    };
+
+    size_t rangeRows = 0, equalRows = 0, allRows = 0, matches = 0;
+    double ms = timeMs([&] {
+        size_t hits = 0;
+        for (const Product& product : rows) hits += product.price >= minPrice && product.price <= maxPrice;
+        return hits;
+    }, rangeRows);
+    report("price range   | per-Product loop", ms, 1, rangeRows, rangeRows);
+    ms = timeMs([&] {
+        size_t hits = 0;
+        for (const Product& product : rows) hits += product.categoryCode == code;
+        return hits;
+    }, equalRows);
+    report("category      | per-Product loop", ms, 1, equalRows, equalRows);
+    ms = timeMs([&] {
+        size_t hits = 0;
+        for (const Product& product : rows) {
+            hits += product.categoryCode == code && product.price >= minPrice && product.price <= maxPrice &&
+                    product.rating >= minRating && product.rating <= maxRating;
+        }
+        return hits;
+    }, allRows);
+    report("all three     | per-Product loop", ms, 3, allRows, allRows);
+
+    for (const FilterKernels& kernels : supportedFilterKernels()) {
+        string name = kernels.name;
+        ms = timeMs([&] {
+            kernels.rangeMask(columns.price.data(), count, minPrice, maxPrice, mask.data());
+            return countMask(mask.data(), words);
+        }, matches);
+        report("price range   | " + name + " kernel", ms, 1, matches, rangeRows);
+        ms = timeMs([&] {
+            kernels.equalMask(columns.categoryCode.data(), count, code, mask.data());
+            return countMask(mask.data(), words);
+        }, matches);
+        report("category      | " + name + " kernel", ms, 1, matches, equalRows);
+        ms = timeMs([&] {
+            kernels.equalMask(columns.categoryCode.data(), count, code, selected.data());
+            kernels.rangeMask(columns.price.data(), count, minPrice, maxPrice, mask.data());
+            andMask(selected.data(), mask.data(), words);
+            kernels.rangeMask(columns.rating.data(), count, minRating, maxRating, mask.data());
+            andMask(selected.data(), mask.data(), words);
+            return countMask(selected.data(), words);
+        }, matches);
+        report("all three     | " + name + " bitmaps", ms, 3, matches, allRows);
+    }
+}
+
+// Heap allocations per product for each way a catalog is loaded, then ten
+// reloads of the same snapshot to check that neither the node pool nor the
+// resident set grows from one load to the next
+void benchAllocations() {
+    const int n = 1000000;
+    const char* catalogFile = "bench_alloc.dat";
+    const char* legacyFile = "bench_alloc_v1.dat";
+    loadSyntheticCatalog(n, 79);
+    saveProductsToFile(catalogFile);
+    saveLegacyProductsToFile(legacyFile);
+    vector<Product> rows = copyProducts();
+    cout << "=== ALLOCATION BENCHMARK (" << n << " products, " << NODE_BLOCK_SIZE << " nodes per pool block) ===" << endl;
+
+    auto measure = [n](const char* label, const function<void()>& load) {
+        size_t before = heapAllocations.load();
+        auto start = chrono::steady_clock::now();
+        load();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        size_t allocations = heapAllocations.load() - before;
+        cout << label << " | " << fixed << setprecision(1) << setw(7) << ms << " ms | "
+             << setw(8) << allocations << " allocations | " << setprecision(3) << setw(6)
+             << static_cast<double>(allocations) / n << " per product"
+             << (idView.size() == static_cast<size_t>(n) ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    };
+    measure("snapshot load (v2)  ", [catalogFile] { loadProductsFromFile(catalogFile); });
+    measure("legacy load (v1)    ", [legacyFile] { loadProductsFromFile(legacyFile); });
+    measure("bulkLoadProducts    ", [&rows] { bulkLoadProducts(rows); });
+    measure("tree rebuild        ", [] {
+        destroyTree(root);
+        root = buildTreeFromSorted(idView, 0, idView.size());
+    });
+
+    const int reloads = 10;
+    long firstRSS = -1, lastRSS = -1;
+    size_t firstBlocks = 0;
+    for (int r = 0; r < reloads; ++r) {
+        loadProductsFromFile(catalogFile);
+        lastRSS = memoryStatusKB("VmRSS", false);
+        if (r == 0) {
+            firstRSS = lastRSS;
+            firstBlocks = nodePool.blocks.size();
+        }
+    }
+    bool steady = nodePool.live == static_cast<size_t>(n) && nodePool.blocks.size() == firstBlocks;
+    cout << reloads << " snapshot reloads  | node pool " << nodePool.blocks.size() << " blocks, "
+         << nodePool.live << " live nodes | RSS ";
+    if (firstRSS >= 0) {
+        cout << fixed << setprecision(1) << firstRSS / 1024.0 << " MB after the first, "
+             << lastRSS / 1024.0 << " MB after the last";
+        cout.unsetf(ios::fixed);
+    } else {
+        cout << "n/a";
+    }
+    cout << (steady ? "" : " | LEAK") << endl;
+
+    remove(catalogFile);
+    remove(legacyFile);
+}
+
+// Read throughput with 1..N reader threads: ID lookups and a top-10 query,
+// each run against the live catalog behind one mutex (the only safe way to
+// share it before snapshots) and against published snapshots, first with no
+// writer and then with the main thread updating prices and publishing in
+// batches of 100 the whole time
+void benchSnapshotReads() {
+    const int n = 1000000;
+    const double seconds = 0.5;
+    loadSyntheticCatalog(n, 83);
+    vector<int> ids;
+    for (int slot : idView) ids.push_back(columns.id[slot]);
+    int hardware = max(1u, thread::hardware_concurrency());
+    cout << "=== SNAPSHOT READ BENCHMARK (" << n << " products, " << hardware << " hardware threads) ===" << endl;
+
+    auto start = chrono::steady_clock::now();
+    publishSnapshot();
+    double fullMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    Product changed = productAt(idView[n / 2]);
+    changed.price += 1.0f;
+    updateProduct(changed);
+    start = chrono::steady_clock::now();
+    publishSnapshot();
+    double priceMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << fixed << setprecision(1);
+    cout << "publish, every part changed | " << setw(7) << fullMs << " ms" << endl;
+    cout << "publish, one price changed  | " << setw(7) << priceMs << " ms (price column and view copied)" << endl;
+
+    ProductQuery query;
+    query.category = "Kitchen";
+    query.hasPriceRange = true;
+    query.minPrice = 100.0f;
+    query.maxPrice = 200.0f;
+    query.sortKey = SORT_BY_PRICE;
+    query.limit = PAGE_SIZE;
+
+    mutex catalogMutex;
+    // Returns reads per second over all threads and the publishes made meanwhile
+    auto run = [&](int threads, bool snapshots, bool lookups, bool writer, int& publishes) {
+        atomic<bool> stop(false);
+        atomic<long> reads(0);
+        vector<thread> readers;
+        for (int t = 0; t < threads; ++t) {
+            readers.emplace_back([&, t] {
+                mt19937 rng(t + 1);
+                int reader = snapshots ? claimSnapshotReader() : -1;
+                long done = 0;
+                float sink = 0.0f;
+                while (!stop.load(memory_order_relaxed)) {
+                    int id = ids[rng() % ids.size()];
+                    if (snapshots) {
+                        const CatalogSnapshot* snapshot = enterSnapshot(reader);
+                        if (lookups) {
+                            int slot = snapshotFind(*snapshot, id);
+                            if (slot >= 0) sink += (*snapshot->price)[slot];
+                        } else {
+                            sink += snapshotQuery(*snapshot, query).size();
+                        }
+                        leaveSnapshot(reader);
+                    } else {
+                        lock_guard<mutex> lock(catalogMutex);
+                        if (lookups) {
+                            Node* node = searchNode(root, id);
+                            if (node != nullptr) sink += columns.price[node->slot];
+                        } else {
+                            sink += runQuery(query).size();
+                        }
+                    }
+                    done++;
+                }
+                if (snapshots) releaseSnapshotReader(reader);
+                reads += done + (sink < 0.0f);
+            });
+        }
+        mt19937 rng(97);
+        publishes = 0;
+        auto begin = chrono::steady_clock::now();
+        while (chrono::duration<double>(chrono::steady_clock::now() - begin).count() < seconds) {
+            if (!writer) {
+                this_thread::sleep_for(chrono::milliseconds(10));
+                continue;
+            }
+            for (int i = 0; i < 100; ++i) {
+                if (!snapshots) catalogMutex.lock();
+                Product p = productAt(idView[rng() % idView.size()]);
+                p.price = static_cast<float>(rng() % 100000) / 100.0f;
+                updateProduct(p);
+                if (!snapshots) catalogMutex.unlock();
+            }
+            if (snapshots) {
+                publishSnapshot();
+                publishes++;
+            }
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        stop.store(true);
+        for (thread& reader : readers) reader.join();
+        reclaimSnapshots();
+        return reads.load() / elapsed;
+    };
+
+    vector<int> threadCounts;
+    for (int threads = 1; threads <= max(4, hardware); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    for (bool lookups : {true, false}) {
+        for (int threads : threadCounts) {
+            int publishes = 0;
+            double locked = run(threads, false, lookups, false, publishes);
+            double lockedWriter = run(threads, false, lookups, true, publishes);
+            double snapshot = run(threads, true, lookups, false, publishes);
+            double snapshotWriter = run(threads, true, lookups, true, publishes);
+            double scale = lookups ? 1e6 : 1e3;
+            cout << (lookups ? "ID lookups " : "top-10 query") << " | " << setw(2) << threads << " readers | "
+                 << (lookups ? "M/s" : "k/s") << ": mutex " << setw(6) << locked / scale
+                 << ", + writer " << setw(6) << lockedWriter / scale
+                 << " | snapshot " << setw(6) << snapshot / scale
+                 << ", + writer " << setw(6) << snapshotWriter / scale
+                 << " (" << publishes << " publishes)" << endl;
+        }
+    }
+    cout.unsetf(ios::fixed);
+}
+
+// B2B-sized carts: the linked list of Product copies the cart used to be
+// against the hash-indexed cart. The list can only add each product once, so
+// quantity changes are measured on the new cart alone.
+void benchCart() {
+    struct ListNode {
+        Product data;
+        ListNode* next;
+    };
+    const int n = 100000;
+    loadSyntheticCatalog(n, 83);
+    Cart saved = {{}, {}, 0.0, 0};
+    swap(saved, cart);
+    cout << "=== CART BENCHMARK (" << n << " products) ===" << endl;
+
+    for (int lines : {100, 1000, 10000}) {
+        mt19937 rng(lines);
+        vector<int> picks;
+        for (int slot : idView) picks.push_back(slot);
+        shuffle(picks.begin(), picks.end(), rng);
+        picks.resize(lines);
+
+        // The old addToCart/isInCart: walk for membership, walk to the tail, copy the Product
+        auto start = chrono::steady_clock::now();
+        ListNode* head = nullptr;
+        for (int slot : picks) {
+            bool found = false;
+            for (ListNode* node = head; node != nullptr && !found; node = node->next) {
+                found = node->data.id == columns.id[slot];
+            }
+            if (found) continue;
+            ListNode* added = new ListNode{productAt(slot), nullptr};
+            if (head == nullptr) {
+                head = added;
+            } else {
+                ListNode* tail = head;
+                while (tail->next != nullptr) tail = tail->next;
+                tail->next = added;
+            }
+        }
+        double listAddMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        size_t listHits = 0;
+        for (int slot : picks) {
+            for (ListNode* node = head; node != nullptr; node = node->next) {
+                if (node->data.id == columns.id[slot]) {
+                    listHits++;
+                    break;
+                }
+            }
+        }
+        double listFindMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        float listTotal = 0;
+        for (ListNode* node = head; node != nullptr; node = node->next) {
+            listTotal += node->data.price;
+        }
+        double listTotalUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        while (head != nullptr) {
+            ListNode* next = head->next;
+            delete head;
+            head = next;
+        }
+
+        clearCart();
+        start = chrono::steady_clock::now();
+        for (int slot : picks) {
+            addToCart(slot, 1);
+        }
+        double cartAddMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        size_t cartHits = 0;
+        for (int slot : picks) {
+            cartHits += isInCart(columns.id[slot]);
+        }
+        double cartFindMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        for (int slot : picks) {
+            setCartQuantity(columns.id[slot], 1 + rng() % 50);
+        }
+        double cartQuantityMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        for (int slot : picks) {
+            setCartQuantity(columns.id[slot], 1);
+        }
+        bool same = listHits == cartHits && fabs(listTotal - cart.total) < 0.01 * listTotal;
+
+        cout << setw(5) << lines << " lines | " << fixed << setprecision(3)
+             << "add all: list " << setw(9) << listAddMs << " ms, cart " << setw(7) << cartAddMs << " ms"
+             << " | lookups: list " << setw(8) << listFindMs << " ms, cart " << setw(6) << cartFindMs << " ms"
+             << " | total: list " << setprecision(1) << setw(6) << listTotalUs << " us, cart O(1)"
+             << " | set quantities " << setprecision(3) << cartQuantityMs << " ms"
+             << (same ? "" : " | MISMATCH") << endl;
+        cout.unsetf(ios::fixed);
+    }
+
+    swap(saved, cart);
+}
+
+// Shoppers on several threads, each visit opening a session, adding
+// linesPerCart products, changing one quantity, checking out and closing.
+// The sharded manager is run as is and with every call behind one global
+// lock, which is what a single shared cart map would amount to.
+void benchCartSessions() {
+    const int n = 100000;
+    const double seconds = 0.5;
+    const int linesPerCart = 20;
+    loadSyntheticCatalog(n, 89);
+    publishSnapshot();
+    vector<int> ids;
+    for (int slot : idView) ids.push_back(columns.id[slot]);
+    int hardware = max(1u, thread::hardware_concurrency());
+    cout << "=== CART SESSION BENCHMARK (" << n << " products, " << linesPerCart << " lines per cart, "
+         << CART_SHARD_COUNT << " shards, " << hardware << " hardware threads) ===" << endl;
+
+    mutex globalLock;
+    // Returns carts checked out per second over all threads
+    auto run = [&](int threads, bool oneLock) {
+        atomic<bool> stop(false);
+        atomic<long> carts(0), failures(0);
+        vector<thread> shoppers;
+        for (int t = 0; t < threads; ++t) {
+            shoppers.emplace_back([&, t] {
+                mt19937 rng(t + 1);
+                int reader = claimSnapshotReader();
+                auto held = [&]() { return oneLock ? unique_lock<mutex>(globalLock) : unique_lock<mutex>(); };
+                long done = 0, failed = 0;
+                while (!stop.load(memory_order_relaxed)) {
+                    const CatalogSnapshot* snapshot = enterSnapshot(reader);
+                    uint64_t session;
+                    {
+                        auto hold = held();
+                        session = openCartSession();
+                    }
+                    int first = ids[rng() % ids.size()];
+                    for (int i = 0; i < linesPerCart; ++i) {
+                        auto hold = held();
+                        failed += !sessionAddToCart(*snapshot, session, i == 0 ? first : ids[rng() % ids.size()], 1 + rng() % 5);
+                    }
+                    CartReceipt receipt;
+                    {
+                        auto hold = held();
+                        failed += !sessionSetQuantity(session, first, 10);
+                    }
+                    {
+                        auto hold = held();
+                        failed += !sessionCheckout(*snapshot, session, receipt);
+                    }
+                    {
+                        auto hold = held();
+                        failed += !closeCartSession(session);
+                    }
+                    leaveSnapshot(reader);
+                    done++;
+                }
+                releaseSnapshotReader(reader);
+                carts += done;
+                failures += failed;
+            });
+        }
+        this_thread::sleep_for(chrono::duration<double>(seconds));
+        stop = true;
+        for (thread& shopper : shoppers) shopper.join();
+        return failures.load() == 0 ? carts.load() / seconds : -1.0;
+    };
+
+    cout << fixed << setprecision(1);
+    for (int threads : {1, 2, 4, 8}) {
+        double single = run(threads, true);
+        double sharded = run(threads, false);
+        cout << setw(2) << threads << " threads | carts/s: one lock " << setw(9) << single / 1000.0 << "k, sharded "
+             << setw(9) << sharded / 1000.0 << "k | cart ops/s sharded " << setw(7)
+             << sharded * (linesPerCart + 4) / 1e6 << " M" << (single < 0 || sharded < 0 ? " | FAILED" : "") << endl;
+    }
+
+    // Once the spare lists are warm, a visit should not need the heap
+    run(1, false);
+    int reader = claimSnapshotReader();
+    const CatalogSnapshot* snapshot = enterSnapshot(reader);
+    const int visits = 10000;
+    mt19937 rng(5);
+    size_t before = heapAllocations.load();
+    for (int v = 0; v < visits; ++v) {
+        uint64_t session = openCartSession();
+        for (int i = 0; i < linesPerCart; ++i) {
+            sessionAddToCart(*snapshot, session, ids[rng() % ids.size()], 1);
+        }
+        CartReceipt receipt;
+        sessionCheckout(*snapshot, session, receipt);
+        closeCartSession(session);
+    }
+    cout << "allocations per visit, spare carts warm | " << setprecision(3)
+         << static_cast<double>(heapAllocations.load() - before) / visits << endl;
+
+    // Idle carts: open many sessions, then expire them all
+    const int idle = 100000;
+    for (int v = 0; v < idle; ++v) {
+        uint64_t session = openCartSession();
+        sessionAddToCart(*snapshot, session, ids[rng() % ids.size()], 1);
+    }
+    leaveSnapshot(reader);
+    releaseSnapshotReader(reader);
+    auto start = chrono::steady_clock::now();
+    size_t expired = expireIdleCarts(chrono::steady_clock::now());
+    double expireMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "expire " << idle << " idle sessions | " << setprecision(1) << expireMs << " ms"
+         << (expired == static_cast<size_t>(idle) ? "" : " | MISMATCH") << endl;
+    cout.unsetf(ios::fixed);
+}
+
+// Replays generated command streams through runBatch, one per kind of
+// command and one mix, with the answers going to the null device
+void benchBatch() {
+    const int n = 1000000;
+    loadSyntheticCatalog(n, 97);
+#ifdef _WIN32
+    FILE* sink = fopen("NUL", "wb");
+#else
+    FILE* sink = fopen("/dev/null", "wb");
+#endif
+    if (sink == nullptr) return;
+    cout << "=== BATCH BENCHMARK (" << n << " products, " << PAGE_SIZE << " products per answer) ===" << endl;
+
+    static const char* names[] = {"Wireless Mouse", "slim tent", "Vintage Kettle Mini", "dron", "Headphones"};
+    static const char* categories[] = {"Electronics", "Furniture", "Kitchen", "Clothing", "Sports", "Office"};
+    static const char* sortKeys[] = {"id", "price", "rating", "name"};
+    mt19937 rng(3);
+    auto find = [&]() { return "find PID" + to_string(1 + rng() % n) + "\n"; };
+    auto name = [&]() { return string("name ") + names[rng() % 5] + "\n"; };
+    auto category = [&]() { return string("category ") + categories[rng() % 6] + "\n"; };
+    auto price = [&]() {
+        int low = rng() % 990;
+        return "price " + to_string(low) + " " + to_string(low + 10) + "\n";
+    };
+    auto sort = [&]() {
+        return string("sort ") + sortKeys[rng() % 4] + (rng() % 2 ? " desc " : " asc ") + to_string(rng() % 1000) + "\n";
+    };
+    auto cartCommand = [&]() {
+        unsigned pick = rng() % 100;
+        if (pick < 70) return "add PID" + to_string(1 + rng() % n) + " " + to_string(1 + rng() % 5) + "\n";
+        if (pick < 90) return string("cart\n");
+        return string("checkout\n");
+    };
+    auto mixed = [&]() {
+        unsigned pick = rng() % 100;
+        if (pick < 50) return find();
+        if (pick < 60) return name();
+        if (pick < 65) return category();
+        if (pick < 75) return price();
+        if (pick < 85) return sort();
+        return cartCommand();
+    };
+
+    struct Stream {
+        const char* label;
+        int commands;
+        function<string()> next;
+    };
+    vector<Stream> streams = {
+        {"find <id>          ", 500000, find},
+        {"name <text>        ", 500, name},
+        {"category <name>    ", 200000, category},
+        {"price <min> <max>  ", 100000, price},
+        {"sort <key> <order> ", 200000, sort},
+        {"add/cart/checkout  ", 500000, cartCommand},
+        {"mixed              ", 20000, mixed},
+    };
+    for (Stream& stream : streams) {
+        string commands;
+        for (int c = 0; c < stream.commands; ++c) {
+            commands += stream.next();
+        }
+        istringstream in(commands);
+        BatchStats stats;
+        runBatch(in, sink, stats);
+        clearCart();
+        cout << stream.label << " | " << setw(7) << stream.commands << " commands | " << fixed << setprecision(1)
+             << setw(8) << stats.elapsedMs << " ms | " << setprecision(0) << setw(9)
+             << stats.commands / stats.elapsedMs * 1000.0 << " commands/s"
+             << (stats.failed == 0 ? "" : " | FAILED") << endl;
+        cout.unsetf(ios::fixed);
+    }
+    fclose(sink);
+}
+
+// The server on a Unix socket in this process, driven by the load generator
+// at several connection counts and pipeline depths
+void benchServer() {
+#ifdef __linux__
+    const int n = 1000000;
+    loadSyntheticCatalog(n, 97);
+    publishSnapshot();
+    string address = "/tmp/ecommerce-bench-" + to_string(getpid()) + ".sock";
+    ServerStats serverStats;
+    thread server([&]() { runServer(address, 0, serverStats); });
+    int probe = -1;
+    for (int attempt = 0; attempt < 1000 && probe < 0; ++attempt) {
+        probe = connectServer(address);
+        if (probe < 0) this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    if (probe < 0) {
+        stopServer();
+        server.join();
+        return;
+    }
+    close(probe);
+
+    cout << "=== SERVER BENCHMARK (" << n << " products, Unix socket, 2 s per run) ===" << endl;
+    cout << "connections | depth | requests/s |  p50 ms |  p99 ms |  max ms" << endl;
+    for (int connections : {1, 16, 64}) {
+        for (int depth : {1, 32}) {
+            LoadStats load;
+            if (!runLoadGenerator(address, connections, depth, 2.0, load)) continue;
+            cout << setw(11) << connections << " | " << setw(5) << depth << " | " << fixed << setprecision(0)
+                 << setw(10) << load.requests / load.elapsedMs * 1000.0 << " | " << setprecision(3) << setw(7)
+                 << loadPercentile(load, 50) / 1000.0 << " | " << setw(7) << loadPercentile(load, 99) / 1000.0
+                 << " | " << setw(7) << loadPercentile(load, 100) / 1000.0
+                 << (load.failed == 0 ? "" : " | FAILED") << endl;
+            cout.unsetf(ios::fixed);
+        }
+    }
+    stopServer();
+    server.join();
+    cout << "Server answered " << serverStats.requests << " requests on " << serverStats.connections
+         << " connections" << endl;
+#else
+    cout << "=== SERVER BENCHMARK skipped: the server needs Linux ===" << endl;
+#endif
+}
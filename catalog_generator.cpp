@@ -0,0 +1,137 @@
+#include "catalog_generator.h"
+
+using namespace std;
+
+CatalogSpec defaultCatalogSpec(int count, unsigned seed) {
+    CatalogSpec spec;
+    spec.count = count;
+    spec.seed = seed;
+    spec.categories = {"Electronics", "Furniture", "Kitchen", "Clothing", "Sports", "Office"};
+    spec.categoryDistribution = DISTRIBUTION_UNIFORM;
+    spec.minPrice = 0.0f;
+    spec.maxPrice = 1000.0f;
+    spec.priceDistribution = DISTRIBUTION_UNIFORM;
+    spec.minRating = 1.0f;
+    spec.maxRating = 5.0f;
+    spec.ratingDistribution = DISTRIBUTION_UNIFORM;
+    return spec;
+}
+
+CatalogSpec skewedCatalogSpec(int count, unsigned seed) {
+    CatalogSpec spec = defaultCatalogSpec(count, seed);
+    spec.categoryDistribution = DISTRIBUTION_SKEWED;
+    spec.priceDistribution = DISTRIBUTION_SKEWED;
+    spec.ratingDistribution = DISTRIBUTION_SKEWED;
+    return spec;
+}
+
+bool parseCatalogDistribution(const string& text, CatalogDistribution& distribution) {
+    if (text == "uniform") {
+        distribution = DISTRIBUTION_UNIFORM;
+    } else if (text == "skewed") {
+        distribution = DISTRIBUTION_SKEWED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Generates spec.count products with IDs 1..count. The spec's categories are
+// interned first, so the codes the products carry are valid in this process.
+// Names are two or three words from a fixed vocabulary, so name searches
+// return result sets of a realistic size.
+vector<Product> generateCatalog(const CatalogSpec& spec) {
+    static const char* adjectives[] = {
+        "Wireless", "Smart", "Portable", "Compact", "Classic", "Premium", "Ergonomic",
+        "Digital", "Vintage", "Modern", "Rugged", "Slim", "Deluxe", "Outdoor", "Mini"};
+    static const char* nouns[] = {
+        "Mouse", "Keyboard", "Speaker", "Lamp", "Chair", "Desk", "Camera", "Watch",
+        "Backpack", "Bottle", "Charger", "Headphones", "Monitor", "Router", "Blender",
+        "Kettle", "Jacket", "Sneakers", "Tent", "Drone"};
+    const unsigned adjectiveCount = sizeof(adjectives) / sizeof(adjectives[0]);
+    const unsigned nounCount = sizeof(nouns) / sizeof(nouns[0]);
+
+    const vector<string>& categories = spec.categories.empty()
+        ? defaultCatalogSpec(0, 0).categories : spec.categories;
+    vector<int> codes;
+    vector<double> cumulative;
+    double weightSum = 0.0;
+    for (size_t c = 0; c < categories.size(); ++c) {
+        codes.push_back(internCategory(categories[c]));
+        double weight = 1.0;
+        if (c < spec.categoryWeights.size()) {
+            weight = max(0.0, spec.categoryWeights[c]);
+        } else if (spec.categoryDistribution == DISTRIBUTION_SKEWED) {
+            weight = 1.0 / (c + 1);
+        }
+        weightSum += weight;
+        cumulative.push_back(weightSum);
+    }
+    if (weightSum <= 0.0) {
+        for (size_t c = 0; c < cumulative.size(); ++c) {
+            cumulative[c] = static_cast<double>(c + 1);
+        }
+    }
+
+    double lowPrice = max(0.0, static_cast<double>(spec.minPrice));
+    double highPrice = max(lowPrice, static_cast<double>(spec.maxPrice));
+    double logLow = log(max(lowPrice, 1.0));
+    double logHigh = log(max(highPrice, 1.0));
+    bool logPrices = spec.priceDistribution == DISTRIBUTION_SKEWED && logHigh > logLow;
+
+    int lowTenths = static_cast<int>(lround(spec.minRating * 10.0));
+    int highTenths = max(lowTenths, static_cast<int>(lround(spec.maxRating * 10.0)));
+    unsigned ratingSteps = static_cast<unsigned>(highTenths - lowTenths + 1);
+
+    mt19937 rng(spec.seed);
+    vector<Product> products;
+    products.reserve(max(spec.count, 0));
+    for (int i = 1; i <= spec.count; ++i) {
+        Product p;
+        p.id = i;
+        p.name = string(adjectives[rng() % adjectiveCount]) + " " + nouns[rng() % nounCount];
+        if (rng() % 2) p.name += string(" ") + adjectives[rng() % adjectiveCount];
+        p.categoryCode = codes[weightedDraw(cumulative, unitDraw(rng))];
+
+        double unit = unitDraw(rng);
+        double price = logPrices ? exp(logLow + unit * (logHigh - logLow))
+                                 : lowPrice + unit * (highPrice - lowPrice);
+        p.price = static_cast<float>(floor(price * 100.0) / 100.0);
+
+        unsigned step;
+        if (spec.ratingDistribution == DISTRIBUTION_SKEWED) {
+            // The square bunches draws near 0, which is the top rating
+            unit = unitDraw(rng);
+            step = ratingSteps - 1 - static_cast<unsigned>(ratingSteps * unit * unit);
+        } else {
+            step = rng() % ratingSteps;
+        }
+        p.rating = (lowTenths + static_cast<int>(step)) / 10.0f;
+        products.push_back(p);
+    }
+    return products;
+}
+
+// Replaces the catalog with a generated one
+void loadGeneratedCatalog(const CatalogSpec& spec) {
+    vector<Product> products = generateCatalog(spec);
+    idAllocator.nextID = 1;
+    bulkLoadProducts(products);
+}
+
+// Replaces the catalog with n products from the default spec; every --bench
+// suite starts from one of these
+void loadSyntheticCatalog(int n, unsigned seed) {
+    loadGeneratedCatalog(defaultCatalogSpec(n, seed));
+}
+
+// A double in [0, 1) from one 32-bit draw
+double unitDraw(mt19937& rng) {
+    return rng() / 4294967296.0;
+}
+
+// Index of the first cumulative weight above unit * total
+size_t weightedDraw(const vector<double>& cumulative, double unit) {
+    size_t index = upper_bound(cumulative.begin(), cumulative.end(), unit * cumulative.back()) - cumulative.begin();
+    return min(index, cumulative.size() - 1);
+}
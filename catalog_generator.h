@@ -0,0 +1,42 @@
+// Synthetic catalogs for the benchmarks and load tests. A spec names a
+// catalog exactly: the same spec gives the same products on every compiler,
+// because values are drawn from mt19937 output with plain arithmetic instead
+// of the <random> distributions, whose algorithms each library chooses.
+#ifndef CATALOG_GENERATOR_H
+#define CATALOG_GENERATOR_H
+
+#include "ecommerce.h"
+
+// How a generated field spreads over its range. SKEWED gives categories
+// weighted 1/rank, log-uniform prices (many cheap products, few expensive
+// ones) and ratings bunched toward the top, as real review scores are.
+enum CatalogDistribution { DISTRIBUTION_UNIFORM, DISTRIBUTION_SKEWED };
+
+struct CatalogSpec {
+    int count;                          // products, with IDs 1..count
+    unsigned seed;
+    std::vector<std::string> categories;
+    std::vector<double> categoryWeights;     // relative, one per category; empty = categoryDistribution
+    CatalogDistribution categoryDistribution;
+    float minPrice;                     // prices are whole cents in [minPrice, maxPrice);
+    float maxPrice;                     // SKEWED starts at 1.00 at the lowest
+    CatalogDistribution priceDistribution;
+    float minRating;                    // ratings are tenths in [minRating, maxRating]
+    float maxRating;
+    CatalogDistribution ratingDistribution;
+};
+
+// Six categories, uniform prices in [0, 1000) and uniform ratings 1.0-5.0
+CatalogSpec defaultCatalogSpec(int count, unsigned seed);
+// The default spec with every distribution switched to SKEWED
+CatalogSpec skewedCatalogSpec(int count, unsigned seed);
+bool parseCatalogDistribution(const std::string& text, CatalogDistribution& distribution);
+
+std::vector<Product> generateCatalog(const CatalogSpec& spec);
+void loadGeneratedCatalog(const CatalogSpec& spec);
+void loadSyntheticCatalog(int n, unsigned seed);
+
+double unitDraw(std::mt19937& rng);
+size_t weightedDraw(const std::vector<double>& cumulative, double unit);
+
+#endif
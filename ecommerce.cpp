@@ -0,0 +1,4060 @@
+#include "ecommerce.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+// The query server and its load generator are built on epoll
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <csignal>
+#endif
+using namespace std;
+
+#ifdef __linux__
+bool serverAddress(const string& address, sockaddr_storage& storage, socklen_t& length);
+#endif
+
+// The SSE2 and AVX2 filter kernels are compiled per function with target
+// attributes and chosen at run time, so the binary still runs on any x86 CPU
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FILTER_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Global variables
+Node* root = nullptr;
+IDAllocator idAllocator = {1};
+Cart cart = {{}, {}, 0.0, 0};
+CartShard cartShards[CART_SHARD_COUNT];
+atomic<uint64_t> cartSessionCounter(0);
+chrono::seconds cartIdleTimeout(30 * 60);
+NodePool nodePool = {{}, NODE_BLOCK_SIZE, nullptr, 0};
+ProductColumns columns = {};
+vector<int> freeSlots;
+vector<int> sortedViews[SORT_KEY_COUNT];
+vector<int>& idView = sortedViews[SORT_BY_ID];
+vector<string> categoryNames;
+map<string, int> categoryCodes;
+vector<vector<int>> categoryPostings;
+shared_ptr<TokenIndex> nameIndex = make_shared<TokenIndex>();
+shared_ptr<TrigramIndex> trigramIndex = make_shared<TrigramIndex>();
+SortKey displayKey = SORT_BY_ID;
+bool displayAscending = true;
+MutationLog mutationLog = {nullptr, "", "", "", 0, 0, false};
+atomic<const CatalogSnapshot*> publishedSnapshot(nullptr);
+atomic<uint64_t> snapshotEpoch(1);
+SnapshotReader snapshotReaders[MAX_SNAPSHOT_READERS];
+vector<RetiredSnapshot> retiredSnapshots;
+unsigned snapshotStale = SNAPSHOT_ALL;
+atomic<int> serverWakeFd(-1);
+
+// Writes products.dat in the version 2 catalog format. Records are stored in
+// ID order, so record number r becomes slot r when the file is loaded again.
+// Every section is streamed from the live indexes through an ExportWriter:
+// string heap offsets and posting list starts are running sums, so nothing
+// is built up in memory first. The header is written last, once the section
+// table is known. The file is written under a temporary name, synced and
+// renamed over the old one, so a crash leaves either the old snapshot or the
+// new one. Only reads the catalog, which is what lets a compaction child run
+// it while the parent keeps serving the menus.
+bool saveProductsToFile(const string& filename) {
+    size_t count = idView.size();
+
+    // Slot r already holds record r when the store has no holes and is in ID
+    // order (always the case right after a load); otherwise a slot -> record
+    // table translates the views and postings
+    bool identity = freeSlots.empty() && columns.id.size() == count;
+    for (size_t r = 0; r < count && identity; ++r) {
+        identity = idView[r] == static_cast<int>(r);
+    }
+    vector<int32_t> recordOf;
+    if (!identity) {
+        recordOf.assign(columns.id.size(), -1);
+        for (size_t r = 0; r < count; ++r) {
+            recordOf[idView[r]] = r;
+        }
+    }
+    auto recordNumber = [&identity, &recordOf](int slot) { return identity ? slot : recordOf[slot]; };
+
+    uint64_t nameBytes = 0, categoryBytes = 0, tokenBytes = 0;
+    for (int slot : idView) nameBytes += columns.name[slot].length;
+    for (const string& category : categoryNames) categoryBytes += category.size();
+    for (const auto& entry : *nameIndex) tokenBytes += entry.first.size();
+    if (nameBytes + categoryBytes + tokenBytes > numeric_limits<uint32_t>::max()) {
+        cerr << "Error: Catalog strings exceed 4 GB; not saved." << endl;
+        return false;
+    }
+
+    string tempName = filename + ".tmp";
+    ExportWriter out;
+    if (!openExport(out, tempName)) {
+        cerr << "Error: Could not open file for writing: " << tempName << endl;
+        return false;
+    }
+
+    CatalogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.version = CATALOG_VERSION;
+    header.endianTag = CATALOG_ENDIAN_TAG;
+    header.recordCount = count;
+    header.categoryCount = categoryNames.size();
+    header.nextID = idAllocator.nextID;
+    header.sectionCount = SECTION_COUNT;
+    writeExport(out, &header, sizeof(header));
+
+    // Each section starts 8-byte aligned
+    auto beginSection = [&out, &header](CatalogSection id) {
+        padExport(out);
+        header.sectionOffset[id] = exportPosition(out);
+    };
+    auto endSection = [&out, &header](CatalogSection id) {
+        header.sectionSize[id] = exportPosition(out) - header.sectionOffset[id];
+    };
+    auto writeInt = [&out](int32_t value) { writeExport(out, &value, sizeof(value)); };
+
+    beginSection(SECTION_RECORDS);
+    uint64_t heapOffset = 0;
+    for (int slot : idView) {
+        size_t nameLength = columns.name[slot].length;
+        CatalogRecord record = {columns.id[slot], columns.categoryCode[slot], static_cast<uint32_t>(heapOffset),
+                                static_cast<uint32_t>(nameLength), columns.price[slot], columns.rating[slot]};
+        writeExport(out, &record, sizeof(record));
+        heapOffset += nameLength;
+    }
+    endSection(SECTION_RECORDS);
+
+    // String heap: names in record order, then category names, then tokens
+    beginSection(SECTION_STRINGS);
+    for (int slot : idView) {
+        writeExport(out, columnName(slot), columns.name[slot].length);
+    }
+    for (const string& category : categoryNames) {
+        writeExport(out, category.data(), category.size());
+    }
+    for (const auto& entry : *nameIndex) {
+        writeExport(out, entry.first.data(), entry.first.size());
+    }
+    endSection(SECTION_STRINGS);
+
+    beginSection(SECTION_CATEGORIES);
+    for (const string& category : categoryNames) {
+        CatalogString text = {static_cast<uint32_t>(heapOffset), static_cast<uint32_t>(category.size())};
+        writeExport(out, &text, sizeof(text));
+        heapOffset += category.size();
+    }
+    endSection(SECTION_CATEGORIES);
+
+    const CatalogSection viewSections[SORT_KEY_COUNT] = {
+        SECTION_VIEW_ID, SECTION_VIEW_PRICE, SECTION_VIEW_RATING, SECTION_VIEW_NAME};
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        beginSection(viewSections[key]);
+        for (int slot : sortedViews[key]) {
+            writeInt(recordNumber(slot));
+        }
+        endSection(viewSections[key]);
+    }
+
+    // Posting tables: list count, list headers (starts are running sums),
+    // then the pool, so each index is walked twice instead of copied
+    auto writeListHeader = [&out](uint32_t key, uint32_t keyLength, uint64_t& start, size_t size) {
+        CatalogPostingList list = {key, keyLength, static_cast<uint32_t>(start), static_cast<uint32_t>(size)};
+        writeExport(out, &list, sizeof(list));
+        start += size;
+    };
+    beginSection(SECTION_CATEGORY_POSTINGS);
+    uint64_t listCount = categoryPostings.size();
+    uint64_t start = 0;
+    writeExport(out, &listCount, sizeof(listCount));
+    for (const vector<int>& postings : categoryPostings) {
+        writeListHeader(0, 0, start, postings.size());
+    }
+    for (const vector<int>& postings : categoryPostings) {
+        for (int slot : postings) writeInt(recordNumber(slot));
+    }
+    endSection(SECTION_CATEGORY_POSTINGS);
+
+    beginSection(SECTION_NAME_TOKENS);
+    listCount = nameIndex->size();
+    start = 0;
+    writeExport(out, &listCount, sizeof(listCount));
+    for (const auto& entry : *nameIndex) {
+        writeListHeader(static_cast<uint32_t>(heapOffset), static_cast<uint32_t>(entry.first.size()), start, entry.second.size());
+        heapOffset += entry.first.size();
+    }
+    for (const auto& entry : *nameIndex) {
+        writeExport(out, entry.second.data(), entry.second.size() * sizeof(int32_t));
+    }
+    endSection(SECTION_NAME_TOKENS);
+
+    beginSection(SECTION_TRIGRAMS);
+    listCount = trigramIndex->size();
+    start = 0;
+    writeExport(out, &listCount, sizeof(listCount));
+    for (const auto& entry : *trigramIndex) {
+        writeListHeader(entry.first, 0, start, entry.second.size());
+    }
+    vector<int32_t> records;
+    for (const auto& entry : *trigramIndex) {
+        if (identity) {
+            writeExport(out, entry.second.data(), entry.second.size() * sizeof(int32_t));
+            continue;
+        }
+        // Slot order is not record order once slots have been reused
+        records.clear();
+        for (int slot : entry.second) records.push_back(recordOf[slot]);
+        sort(records.begin(), records.end());
+        writeExport(out, records.data(), records.size() * sizeof(int32_t));
+    }
+    endSection(SECTION_TRIGRAMS);
+    padExport(out);
+
+    // The section table is complete; put the header in place
+    if (!rewindExport(out)) {
+        out.failed = true;
+    }
+    writeExport(out, &header, sizeof(header));
+    if (!closeExport(out)) {
+        cerr << "Error: Could not write " << tempName << endl;
+        remove(tempName.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    remove(filename.c_str());
+#endif
+    if (rename(tempName.c_str(), filename.c_str()) != 0) {
+        cerr << "Error: Could not replace " << filename << endl;
+        return false;
+    }
+    return syncPath(directoryOf(filename));
+}
+
+// Writes the catalog as CSV (id,name,category,price,rating) in ID order. The
+// tree is walked in order with a fixed stack and rows are formatted straight
+// into the export buffer, so memory stays O(buffer). The file can be fed back
+// to importProductsFromFile, which ignores the id column.
+bool exportProductsToCSV(const string& filename) {
+    ExportWriter out;
+    if (!openExport(out, filename)) {
+        cerr << "Error: Could not open file for writing: " << filename << endl;
+        return false;
+    }
+    const char header[] = "id,name,category,price,rating\n";
+    writeExport(out, header, sizeof(header) - 1);
+
+    // Names and categories only hold letters and spaces, but quote anything
+    // a CSV reader would split on
+    auto writeText = [&out](const char* text, size_t length) {
+        const char* end = text + length;
+        if (find_if(text, end, [](char c) { return c == ',' || c == '"' || c == '\r' || c == '\n'; }) == end) {
+            writeExport(out, text, length);
+            return;
+        }
+        writeExport(out, "\"", 1);
+        for (const char* c = text; c != end; ++c) {
+            if (*c == '"') writeExport(out, "\"", 1);
+            writeExport(out, c, 1);
+        }
+        writeExport(out, "\"", 1);
+    };
+
+    Node* stack[MAX_TREE_HEIGHT];
+    int top = 0;
+    Node* current = root;
+    while (current != nullptr || top > 0) {
+        while (current != nullptr) {
+            stack[top++] = current;
+            current = current->left;
+        }
+        current = stack[--top];
+        int slot = current->slot;
+        const string& category = categoryName(columns.categoryCode[slot]);
+        char id[24];
+        writeExport(out, id, snprintf(id, sizeof(id), "PID%02d,", columns.id[slot]));
+        writeText(columnName(slot), columns.name[slot].length);
+        writeExport(out, ",", 1);
+        writeText(category.data(), category.size());
+        writeExport(out, ",", 1);
+        writeExportNumber(out, columns.price[slot]);
+        writeExport(out, ",", 1);
+        writeExportNumber(out, columns.rating[slot]);
+        writeExport(out, "\n", 1);
+        current = current->right;
+    }
+
+    if (!closeExport(out)) {
+        cerr << "Error: Could not write " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+bool openExport(ExportWriter& out, const string& filename) {
+    out.file = fopen(filename.c_str(), "wb");
+    out.buffer.resize(EXPORT_BUFFER_SIZE);
+    out.used = 0;
+    out.flushed = 0;
+    out.failed = out.file == nullptr;
+    return !out.failed;
+}
+
+// Prices and ratings are almost always whole cents, which integer formatting
+// prints exactly and far faster than %g; anything else gets enough digits to
+// read back as the same float
+void writeExportNumber(ExportWriter& out, float value) {
+    char text[32];
+    int length;
+    double cents = nearbyint(double(value) * 100.0);
+    if (cents >= 0 && cents < 1e15 && float(cents / 100.0) == value) {
+        long long whole = (long long)cents;
+        length = snprintf(text, sizeof(text), "%lld.%02lld", whole / 100, whole % 100);
+        while (text[length - 1] == '0') length--;
+        if (text[length - 1] == '.') length--;
+    } else {
+        length = snprintf(text, sizeof(text), "%.9g", value);
+    }
+    writeExport(out, text, length);
+}
+
+void writeExport(ExportWriter& out, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    if (out.used + size > out.buffer.size()) {
+        // A writer without a file keeps everything, for answers that are
+        // sent over a socket
+        if (out.file == nullptr) {
+            out.buffer.resize(max(out.buffer.size() * 2, out.used + size));
+        } else {
+            flushExport(out);
+            // Blocks larger than the whole buffer go straight to the file
+            if (size > out.buffer.size()) {
+                out.failed = out.failed || fwrite(bytes, 1, size, out.file) != size;
+                out.flushed += size;
+                return;
+            }
+        }
+    }
+    memcpy(out.buffer.data() + out.used, bytes, size);
+    out.used += size;
+}
+
+void flushExport(ExportWriter& out) {
+    if (out.used == 0 || out.file == nullptr) return;
+    out.failed = out.failed || fwrite(out.buffer.data(), 1, out.used, out.file) != out.used;
+    out.flushed += out.used;
+    out.used = 0;
+}
+
+void padExport(ExportWriter& out) {
+    const char padding[8] = {0};
+    writeExport(out, padding, (8 - exportPosition(out) % 8) % 8);
+}
+
+uint64_t exportPosition(const ExportWriter& out) {
+    return out.flushed + out.used;
+}
+
+// Moves back to the start of the file, for headers that are written last
+bool rewindExport(ExportWriter& out) {
+    flushExport(out);
+    out.flushed = 0;
+    return fseek(out.file, 0, SEEK_SET) == 0;
+}
+
+// Flushes, fsyncs and closes; false if any write failed
+bool closeExport(ExportWriter& out) {
+    flushExport(out);
+    bool ok = !out.failed && fflush(out.file) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(out.file)) == 0;
+#else
+    ok = ok && fsync(fileno(out.file)) == 0;
+#endif
+    ok = fclose(out.file) == 0 && ok;
+    out.file = nullptr;
+    vector<char>().swap(out.buffer);
+    return ok;
+}
+
+// Loads products.dat in either format: version 2 files are mapped and read in
+// place, anything else is handed to the version 1 reader for migration.
+// Returns false if a version 2 file was rejected; a missing file is an empty
+// catalog.
+bool loadProductsFromFile(const string& filename) {
+    MappedFile file;
+    if (!mapFile(filename, file)) {
+        cerr << "Info: No existing data file found. Starting with empty product list." << endl;
+        return true;
+    }
+
+    bool isCatalog = file.size >= sizeof(CATALOG_MAGIC) &&
+                     memcmp(file.data, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) == 0;
+    bool loaded = !isCatalog || loadCatalogImage(file);
+    if (!loaded) {
+        cerr << "Error: " << filename << " is damaged or from a newer version; the catalog was not changed." << endl;
+    }
+    unmapFile(file);
+
+    if (!isCatalog) {
+        loadLegacyProductsFromFile(filename);
+    }
+    return loaded;
+}
+
+// Resets every product structure before a load. The category dictionary is
+// kept so codes held by Product copies stay valid; only its postings are
+// emptied. Cart lines keep their IDs and are relinked once the load is done.
+void clearCatalog() {
+    // Every pooled node belongs to the catalog tree unless a caller still
+    // holds a tree of its own, so the blocks can usually go back in one step
+    if (nodePool.live == idView.size()) {
+        releaseNodePool();
+    } else {
+        destroyTree(root);
+    }
+    root = nullptr;
+    freeSlots.clear();
+    columns = ProductColumns();
+    snapshotStale = SNAPSHOT_ALL;
+    for (auto& view : sortedViews) {
+        view.clear();
+    }
+    // Fresh indexes rather than clear(): a snapshot may still share the old ones
+    nameIndex = make_shared<TokenIndex>();
+    trigramIndex = make_shared<TrigramIndex>();
+    for (auto& postings : categoryPostings) {
+        postings.clear();
+    }
+    displayKey = SORT_BY_ID;
+    displayAscending = true;
+}
+
+// Rebuilds the in-memory catalog from a mapped version 2 image. Everything is
+// checked before any state changes, so a damaged file leaves the previous
+// catalog untouched instead of half loaded. Returns false if the image is invalid.
+bool loadCatalogImage(const MappedFile& file) {
+    if (file.size < sizeof(CatalogHeader)) return false;
+    CatalogHeader header;
+    memcpy(&header, file.data, sizeof(header));
+    if (header.version != CATALOG_VERSION || header.endianTag != CATALOG_ENDIAN_TAG) return false;
+    if (header.sectionCount < SECTION_COUNT || header.sectionCount > CATALOG_MAX_SECTIONS) return false;
+    for (int i = 0; i < SECTION_COUNT; ++i) {
+        if (header.sectionOffset[i] % 8 != 0 || header.sectionOffset[i] > file.size ||
+            header.sectionSize[i] > file.size - header.sectionOffset[i]) return false;
+    }
+
+    size_t count = header.recordCount;
+    auto section = [&](CatalogSection id) { return file.data + header.sectionOffset[id]; };
+    const CatalogRecord* records = reinterpret_cast<const CatalogRecord*>(section(SECTION_RECORDS));
+    const char* heap = section(SECTION_STRINGS);
+    uint64_t heapSize = header.sectionSize[SECTION_STRINGS];
+    const CatalogString* categories = reinterpret_cast<const CatalogString*>(section(SECTION_CATEGORIES));
+    if (header.sectionSize[SECTION_RECORDS] != count * sizeof(CatalogRecord) ||
+        header.sectionSize[SECTION_CATEGORIES] != header.categoryCount * sizeof(CatalogString)) return false;
+
+    auto validString = [heapSize](uint32_t offset, uint32_t length) {
+        return static_cast<uint64_t>(offset) + length <= heapSize;
+    };
+    for (uint32_t c = 0; c < header.categoryCount; ++c) {
+        if (!validString(categories[c].offset, categories[c].length)) return false;
+    }
+    for (size_t r = 0; r < count; ++r) {
+        if (!validString(records[r].nameOffset, records[r].nameLength) ||
+            records[r].categoryCode < 0 || static_cast<uint32_t>(records[r].categoryCode) >= header.categoryCount ||
+            (r > 0 && records[r].id <= records[r - 1].id) || records[r].id <= 0) return false;
+    }
+
+    // Each view must list every slot exactly once, and the ID view must be the
+    // record order, since the tree is built from it
+    const int32_t* views[SORT_KEY_COUNT];
+    const CatalogSection viewSections[SORT_KEY_COUNT] = {
+        SECTION_VIEW_ID, SECTION_VIEW_PRICE, SECTION_VIEW_RATING, SECTION_VIEW_NAME};
+    vector<unsigned char> seen(count);
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        if (header.sectionSize[viewSections[key]] != count * sizeof(int32_t)) return false;
+        views[key] = reinterpret_cast<const int32_t*>(section(viewSections[key]));
+        fill(seen.begin(), seen.end(), 0);
+        for (size_t i = 0; i < count; ++i) {
+            int32_t slot = views[key][i];
+            if (slot < 0 || static_cast<size_t>(slot) >= count || seen[slot]) return false;
+            if (key == SORT_BY_ID && static_cast<size_t>(slot) != i) return false;
+            seen[slot] = 1;
+        }
+    }
+
+    // Checks a posting table's layout; poolLimit bounds the values it may hold
+    struct Table { const CatalogPostingList* lists; uint64_t listCount; const int32_t* pool; };
+    auto readTable = [&](CatalogSection id, int64_t poolLimit, Table& table) {
+        uint64_t size = header.sectionSize[id];
+        if (size < sizeof(uint64_t)) return false;
+        memcpy(&table.listCount, section(id), sizeof(uint64_t));
+        if (table.listCount > (size - sizeof(uint64_t)) / sizeof(CatalogPostingList)) return false;
+        uint64_t poolBytes = size - sizeof(uint64_t) - table.listCount * sizeof(CatalogPostingList);
+        if (poolBytes % sizeof(int32_t) != 0) return false;
+        table.lists = reinterpret_cast<const CatalogPostingList*>(section(id) + sizeof(uint64_t));
+        table.pool = reinterpret_cast<const int32_t*>(table.lists + table.listCount);
+        uint64_t poolSize = poolBytes / sizeof(int32_t);
+        for (uint64_t l = 0; l < table.listCount; ++l) {
+            if (static_cast<uint64_t>(table.lists[l].start) + table.lists[l].count > poolSize) return false;
+        }
+        for (uint64_t i = 0; i < poolSize; ++i) {
+            if (table.pool[i] < 0 || table.pool[i] >= poolLimit) return false;
+        }
+        return true;
+    };
+    Table categoryTable, tokenTable, trigramTable;
+    if (!readTable(SECTION_CATEGORY_POSTINGS, count, categoryTable) ||
+        categoryTable.listCount != header.categoryCount) return false;
+    if (!readTable(SECTION_NAME_TOKENS, numeric_limits<int32_t>::max(), tokenTable)) return false;
+    for (uint64_t l = 0; l < tokenTable.listCount; ++l) {
+        if (!validString(tokenTable.lists[l].key, tokenTable.lists[l].keyLength)) return false;
+    }
+    if (!readTable(SECTION_TRIGRAMS, count, trigramTable)) return false;
+
+    // The image is consistent; replace the catalog with it
+    clearCatalog();
+    vector<int> codeOf(header.categoryCount);
+    for (uint32_t c = 0; c < header.categoryCount; ++c) {
+        codeOf[c] = internCategory(string(heap + categories[c].offset, categories[c].length));
+    }
+
+    // Records go straight into the columns and the names into one arena, so
+    // the load makes no per-product allocations
+    resizeColumns(count);
+    size_t nameBytes = 0;
+    for (size_t r = 0; r < count; ++r) {
+        nameBytes += records[r].nameLength;
+    }
+    columns.nameArena.reserve(nameBytes);
+    for (size_t r = 0; r < count; ++r) {
+        const char* name = heap + records[r].nameOffset;
+        columns.id[r] = records[r].id;
+        columns.categoryCode[r] = codeOf[records[r].categoryCode];
+        columns.price[r] = records[r].price;
+        columns.rating[r] = records[r].rating;
+        columns.name[r] = NameSpan{namePrefix(name, records[r].nameLength),
+                                   columns.nameArena.size(), records[r].nameLength};
+        columns.nameArena.insert(columns.nameArena.end(), name, name + records[r].nameLength);
+    }
+
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        sortedViews[key].assign(views[key], views[key] + count);
+    }
+    // Records are in strictly ascending ID order (checked above), so record r
+    // is both slot r and position r of the ID view
+    root = buildTreeFromSorted(idView, 0, count);
+    for (uint64_t l = 0; l < categoryTable.listCount; ++l) {
+        const int32_t* first = categoryTable.pool + categoryTable.lists[l].start;
+        categoryPostings[codeOf[l]].assign(first, first + categoryTable.lists[l].count);
+    }
+    TokenIndex& tokens = writableNameIndex();
+    for (uint64_t l = 0; l < tokenTable.listCount; ++l) {
+        const CatalogPostingList& list = tokenTable.lists[l];
+        const int32_t* first = tokenTable.pool + list.start;
+        // Tokens were written in map order, so each insert lands at the end
+        tokens.emplace_hint(tokens.end(), string(heap + list.key, list.keyLength),
+                            vector<int>(first, first + list.count));
+    }
+    TrigramIndex& trigrams = writableTrigramIndex();
+    trigrams.reserve(trigramTable.listCount);
+    for (uint64_t l = 0; l < trigramTable.listCount; ++l) {
+        const int32_t* first = trigramTable.pool + trigramTable.lists[l].start;
+        trigrams[trigramTable.lists[l].key].assign(first, first + trigramTable.lists[l].count);
+    }
+
+    idAllocator.nextID = max(static_cast<int>(header.nextID), findMaxID(root) + 1);
+    return true;
+}
+
+bool mapFile(const string& filename, MappedFile& file) {
+    file.data = nullptr;
+    file.size = 0;
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    file.size = info.st_size;
+    if (file.size > 0) {
+        void* mapping = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        file.data = static_cast<const char*>(mapping);
+    }
+    close(fd);
+    return true;
+#else
+    ifstream inFile(filename, ios::binary);
+    if (!inFile) return false;
+    file.buffer.assign(istreambuf_iterator<char>(inFile), istreambuf_iterator<char>());
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    return true;
+#endif
+}
+
+void unmapFile(MappedFile& file) {
+#ifndef _WIN32
+    if (file.data != nullptr) {
+        munmap(const_cast<char*>(file.data), file.size);
+    }
+#endif
+    file.buffer.clear();
+    file.data = nullptr;
+    file.size = 0;
+}
+
+// Replaces the catalog with the given products. Input in strictly ascending
+// ID order (what every save writes) is recognised in one pass and goes
+// straight in; anything else is stably sorted by ID first, keeping the first
+// of any duplicate IDs. The tree is then built in O(n) and the ID view is the
+// store order; the name and category postings are all appends. The price,
+// rating and name views still need an O(n log n) sort by value.
+void bulkLoadProducts(vector<Product>& products) {
+    clearCatalog();
+
+    bool sortedInput = true;
+    for (size_t i = 1; i < products.size() && sortedInput; ++i) {
+        sortedInput = products[i - 1].id < products[i].id;
+    }
+    if (!sortedInput) {
+        stable_sort(products.begin(), products.end(),
+            [](const Product& a, const Product& b) { return a.id < b.id; });
+        products.erase(unique(products.begin(), products.end(),
+            [](const Product& a, const Product& b) { return a.id == b.id; }), products.end());
+    }
+
+    size_t nameBytes = 0;
+    for (const Product& product : products) {
+        nameBytes += product.name.size();
+    }
+    resizeColumns(products.size());
+    columns.nameArena.reserve(nameBytes);
+    for (int slot = 0; slot < static_cast<int>(products.size()); ++slot) {
+        storeColumns(slot, products[slot]);
+        indexProductName(products[slot].id, slot, products[slot].name);
+        indexProductCategory(slot);
+    }
+    rebuildSortedViews();
+    root = buildTreeFromSorted(idView, 0, idView.size());
+    if (!products.empty()) {
+        idAllocator.nextID = max(idAllocator.nextID, products.back().id + 1);
+    }
+    products.clear();
+    relinkCart();
+}
+
+// Writes the version 1 layout: a size_t count, then per product three
+// length-prefixed strings and two floats, then the NXID trailer. Only kept so
+// the migration path and --bench load can produce old files.
+void saveLegacyProductsToFile(const string& filename) {
+    ofstream outFile(filename, ios::binary);
+    if (!outFile) {
+        cerr << "Error: Could not open file for writing: " << filename << endl;
+        return;
+    }
+    
+    // Write the number of products
+    size_t numProducts = idView.size();
+    outFile.write(reinterpret_cast<const char*>(&numProducts), sizeof(numProducts));
+    
+    // Write each product in ID order straight from the store
+    for (int slot : idView) {
+        Product product = productAt(slot);
+        
+        // Write ID (stored in its display form for compatibility)
+        string idText = formatProductID(product.id);
+        size_t idSize = idText.size();
+        outFile.write(reinterpret_cast<const char*>(&idSize), sizeof(idSize));
+        outFile.write(idText.c_str(), idSize);
+        
+        // Write name
+        size_t nameSize = product.name.size();
+        outFile.write(reinterpret_cast<const char*>(&nameSize), sizeof(nameSize));
+        outFile.write(product.name.c_str(), nameSize);
+        
+        // Write category
+        const string& category = categoryName(product.categoryCode);
+        size_t categorySize = category.size();
+        outFile.write(reinterpret_cast<const char*>(&categorySize), sizeof(categorySize));
+        outFile.write(category.c_str(), categorySize);
+        
+        // Write price and rating
+        outFile.write(reinterpret_cast<const char*>(&product.price), sizeof(product.price));
+        outFile.write(reinterpret_cast<const char*>(&product.rating), sizeof(product.rating));
+    }
+    
+    // Write the ID allocator high-water mark
+    outFile.write(ID_TRAILER_TAG, sizeof(ID_TRAILER_TAG));
+    outFile.write(reinterpret_cast<const char*>(&idAllocator.nextID), sizeof(idAllocator.nextID));
+    
+    outFile.close();
+}
+
+// Reads the version 1 layout written before the catalog format existed.
+// The next save rewrites the file as version 2.
+void loadLegacyProductsFromFile(const string& filename) {
+    ifstream inFile(filename, ios::binary);
+    if (!inFile) return;
+    
+    // Read the number of products
+    size_t numProducts = 0;
+    inFile.read(reinterpret_cast<char*>(&numProducts), sizeof(numProducts));
+    
+    // Length prefixes are checked against the file size, so a damaged file
+    // stops the load early instead of asking for a huge allocation
+    inFile.seekg(0, ios::end);
+    size_t fileSize = inFile.tellg();
+    inFile.seekg(sizeof(numProducts));
+    auto readText = [&inFile, fileSize](string& text) {
+        size_t size = 0;
+        if (!inFile.read(reinterpret_cast<char*>(&size), sizeof(size)) || size > fileSize) return false;
+        text.resize(size);
+        return static_cast<bool>(inFile.read(&text[0], size));
+    };
+    
+    // Read each product
+    vector<Product> products;
+    string idText, category;
+    for (size_t i = 0; i < numProducts; ++i) {
+        Product product;
+        
+        // Read ID, name and category
+        if (!readText(idText) || !readText(product.name) || !readText(category)) break;
+        product.id = parseProductID(idText);
+        product.categoryCode = internCategory(category);
+        
+        // Read price and rating
+        inFile.read(reinterpret_cast<char*>(&product.price), sizeof(product.price));
+        inFile.read(reinterpret_cast<char*>(&product.rating), sizeof(product.rating));
+        if (!inFile || product.id <= 0) break;
+        
+        products.push_back(product);
+    }
+    idAllocator.nextID = 1;
+    bulkLoadProducts(products);
+    
+    // Restore the ID high-water mark; files from older versions have no trailer,
+    // so fall back to one past the largest stored ID
+    char tag[sizeof(ID_TRAILER_TAG)];
+    int savedNextID = 0;
+    if (inFile.read(tag, sizeof(tag)) && equal(tag, tag + sizeof(tag), ID_TRAILER_TAG)) {
+        inFile.read(reinterpret_cast<char*>(&savedNextID), sizeof(savedNextID));
+    }
+    idAllocator.nextID = max(savedNextID, findMaxID(root) + 1);
+    
+    inFile.close();
+}
+
+// Loads the snapshot, replays the logs written since (a sealed log first, if
+// a compaction was interrupted) and reopens the log for appending. Returns
+// the number of log records replayed.
+//
+// A snapshot that is rejected stays on disk as it is: its logs are neither
+// replayed nor reopened, and mutationLog.loadFailed makes Save and every
+// compaction refuse until a later openCatalog succeeds. Otherwise the next
+// save would write the (empty) catalog in memory over it.
+size_t openCatalog(const string& filename) {
+    closeMutationLog();
+    mutationLog.catalogPath = filename;
+    string logPath = filename + ".wal";
+    // Before the first compaction there is only a log
+    bool loaded = true;
+    if (fileExists(filename) || !fileExists(logPath)) {
+        loaded = loadProductsFromFile(filename);
+    } else {
+        clearCatalog();
+    }
+    mutationLog.loadFailed = !loaded;
+    if (!loaded) return 0;
+
+    bool interrupted = fileExists(logPath + ".old");
+    size_t replayed = replayMutationLog(logPath + ".old") + replayMutationLog(logPath);
+    openMutationLog(filename);
+    if (interrupted) {
+        compactCatalog(false);
+    }
+    relinkCart();
+    refreshSnapshot();
+    return replayed;
+}
+
+bool openMutationLog(const string& catalogFilename) {
+    mutationLog.catalogPath = catalogFilename;
+    mutationLog.path = catalogFilename + ".wal";
+    return startMutationLog(false);
+}
+
+// Opens mutationLog.path for appending, or empties it first when truncate is
+// set, and writes the file header if the log is new
+bool startMutationLog(bool truncate) {
+    if (mutationLog.file != nullptr) {
+        fclose(mutationLog.file);
+    }
+    mutationLog.pending.clear();
+    mutationLog.file = fopen(mutationLog.path.c_str(), truncate ? "wb" : "ab");
+    if (mutationLog.file == nullptr) {
+        cerr << "Warning: Could not open " << mutationLog.path << "; changes are only kept by Save." << endl;
+        return false;
+    }
+    fseek(mutationLog.file, 0, SEEK_END);
+    mutationLog.size = ftell(mutationLog.file);
+    if (mutationLog.size == 0) {
+        LogFileHeader header;
+        memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+        header.version = LOG_VERSION;
+        header.endianTag = CATALOG_ENDIAN_TAG;
+        mutationLog.pending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        mutationLog.size = sizeof(header);
+        return flushMutationLog() && syncPath(directoryOf(mutationLog.path));
+    }
+    return true;
+}
+
+void closeMutationLog() {
+    finishCompaction(true);
+    if (mutationLog.file == nullptr) return;
+    flushMutationLog();
+    fclose(mutationLog.file);
+    mutationLog.file = nullptr;
+}
+
+// Queues one record; nothing reaches the disk until the next flush. The
+// category is logged as text because codes are only stable within a run.
+void logMutation(LogOp op, const Product& p) {
+    if (mutationLog.file == nullptr) return;
+
+    const string& category = categoryName(p.categoryCode);
+    LogRecord record = {static_cast<uint32_t>(op), p.id, p.price, p.rating,
+                        static_cast<uint32_t>(p.name.size()), static_cast<uint32_t>(category.size())};
+    string payload(reinterpret_cast<const char*>(&record), sizeof(record));
+    payload += p.name;
+    payload += category;
+
+    LogRecordHeader header = {static_cast<uint32_t>(payload.size()), computeCRC32(payload.data(), payload.size())};
+    mutationLog.pending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    mutationLog.pending += payload;
+    mutationLog.size += sizeof(header) + payload.size();
+}
+
+// Writes the pending records with one write and one fsync
+bool flushMutationLog() {
+    if (mutationLog.file == nullptr) return false;
+    if (mutationLog.pending.empty()) return true;
+
+    FILE* file = mutationLog.file;
+    bool ok = fwrite(mutationLog.pending.data(), 1, mutationLog.pending.size(), file) == mutationLog.pending.size() &&
+              fflush(file) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    if (!ok) {
+        cerr << "Error: Could not write " << mutationLog.path << "; recent changes may be lost." << endl;
+    }
+    mutationLog.pending.clear();
+    return ok;
+}
+
+// Ends a batch of mutations: makes them durable and starts a background
+// compaction once the log has grown past LOG_COMPACT_BYTES
+bool syncMutationLog() {
+    refreshSnapshot();
+    if (!flushMutationLog()) return false;
+    finishCompaction(false);
+    if (mutationLog.size > LOG_COMPACT_BYTES) {
+        compactCatalog(false);
+    }
+    return true;
+}
+
+// Applies every intact record of a log to the catalog. The first record whose
+// length does not fit or whose checksum fails is a write torn by a crash; it
+// and everything after it are cut off. Adds and updates are applied as
+// upserts and removes of missing IDs are ignored, so replaying a log over a
+// snapshot that already contains it gives the same catalog. Returns the
+// number of records applied.
+size_t replayMutationLog(const string& path) {
+    MappedFile file;
+    if (!mapFile(path, file)) return 0;
+
+    size_t applied = 0;
+    size_t valid = 0;
+    LogFileHeader header;
+    if (file.size >= sizeof(header)) {
+        memcpy(&header, file.data, sizeof(header));
+        if (memcmp(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) == 0 &&
+            header.version == LOG_VERSION && header.endianTag == CATALOG_ENDIAN_TAG) {
+            valid = sizeof(header);
+        }
+    }
+
+    while (valid > 0 && file.size - valid >= sizeof(LogRecordHeader)) {
+        LogRecordHeader recordHeader;
+        memcpy(&recordHeader, file.data + valid, sizeof(recordHeader));
+        const char* payload = file.data + valid + sizeof(recordHeader);
+        if (recordHeader.length < sizeof(LogRecord) ||
+            recordHeader.length > file.size - valid - sizeof(recordHeader) ||
+            computeCRC32(payload, recordHeader.length) != recordHeader.checksum) break;
+
+        LogRecord record;
+        memcpy(&record, payload, sizeof(record));
+        if (sizeof(record) + static_cast<uint64_t>(record.nameLength) + record.categoryLength != recordHeader.length ||
+            record.op < LOG_ADD || record.op > LOG_REMOVE || record.id <= 0) break;
+
+        if (record.op == LOG_REMOVE) {
+            removeProduct(record.id);
+        } else {
+            const char* text = payload + sizeof(record);
+            Product product;
+            product.id = record.id;
+            product.name.assign(text, record.nameLength);
+            product.categoryCode = internCategory(string(text + record.nameLength, record.categoryLength));
+            product.price = record.price;
+            product.rating = record.rating;
+            if (searchNode(root, product.id) != nullptr) {
+                updateProduct(product);
+            } else {
+                addProduct(product);
+            }
+        }
+        valid += sizeof(recordHeader) + recordHeader.length;
+        ++applied;
+    }
+
+    size_t size = file.size;
+    string intact(file.data == nullptr ? "" : string(file.data, valid));
+    unmapFile(file);
+    if (valid < size) {
+        cerr << "Warning: " << path << " ends with " << size - valid
+             << " bytes of damaged or incomplete records; they were discarded." << endl;
+        ofstream outFile(path, ios::binary | ios::trunc);
+        outFile.write(intact.data(), intact.size());
+        outFile.close();
+        syncPath(path);
+    }
+    return applied;
+}
+
+// Writes a fresh snapshot and drops the log records it now contains. The
+// current log is sealed (renamed to .wal.old) and a new one started; a forked
+// child then writes the snapshot from its copy-on-write image of the catalog
+// and deletes the sealed log, so the menu never waits for the O(n) write.
+// Without fork, while other threads are running (server workers or importer
+// threads could hold the malloc or stdio locks the child would need), or while
+// a sealed log from a failed compaction is still on disk, the snapshot is
+// written in the foreground instead. Only one
+// compaction runs at a time; with wait set this blocks until it is done.
+bool compactCatalog(bool wait) {
+    if (mutationLog.file == nullptr || mutationLog.loadFailed) return false;
+    if (mutationLog.compactor != 0) {
+        if (!wait) return false;
+        finishCompaction(true);
+    }
+    if (!flushMutationLog()) return false;
+
+    string sealedPath = mutationLog.path + ".old";
+    string directory = directoryOf(mutationLog.path);
+#ifndef _WIN32
+    if (!fileExists(sealedPath) && processIsSingleThreaded()) {
+        fclose(mutationLog.file);
+        mutationLog.file = nullptr;
+        if (rename(mutationLog.path.c_str(), sealedPath.c_str()) == 0 && syncPath(directory) &&
+            startMutationLog(true)) {
+            cout.flush();
+            pid_t child = fork();
+            if (child == 0) {
+                bool saved = saveProductsToFile(mutationLog.catalogPath) &&
+                             remove(sealedPath.c_str()) == 0 && syncPath(directory);
+                _exit(saved ? 0 : 1);
+            }
+            if (child > 0) {
+                mutationLog.compactor = child;
+                return wait ? finishCompaction(true) : true;
+            }
+        }
+    }
+#endif
+
+    if (!saveProductsToFile(mutationLog.catalogPath)) return false;
+    remove(sealedPath.c_str());
+    return startMutationLog(true);
+}
+
+// The Save command: folds the log into a fresh snapshot of the file the
+// catalog was opened from, or writes that snapshot directly when no log is
+// open. Refuses while that file is one openCatalog could not load.
+bool saveCatalog() {
+    if (mutationLog.loadFailed) return false;
+    if (compactCatalog(true)) return true;
+    return mutationLog.file == nullptr && saveProductsToFile(catalogFilePath());
+}
+
+// The snapshot file given to openCatalog, products.dat before any was opened
+string catalogFilePath() {
+    return mutationLog.catalogPath.empty() ? "products.dat" : mutationLog.catalogPath;
+}
+
+// Reaps the background compaction. Returns false if it failed, or if it is
+// still running and wait is not set.
+bool finishCompaction(bool wait) {
+#ifndef _WIN32
+    if (mutationLog.compactor == 0) return true;
+    int status = 0;
+    pid_t done = waitpid(mutationLog.compactor, &status, wait ? 0 : WNOHANG);
+    if (done == 0) return false;
+    mutationLog.compactor = 0;
+    if (done < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cerr << "Warning: Background compaction failed; the sealed log is kept and replayed at startup." << endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+// True when the calling thread is the only one in the process. Threads are
+// started only by the thread that mutates the catalog, so the answer cannot
+// go stale before that thread acts on it. Where the count is not available
+// this answers false, which only costs a foreground write.
+bool processIsSingleThreaded() {
+#ifdef __linux__
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) {
+            return atol(line.c_str() + 8) == 1;
+        }
+    }
+#endif
+    return false;
+}
+
+// CRC-32 (IEEE polynomial, reflected), table driven
+uint32_t computeCRC32(const char* data, size_t size) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Flushes a file or directory to stable storage. Directories are synced after
+// a rename so the new name survives a crash too.
+bool syncPath(const string& path) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+string directoryOf(const string& path) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash == string::npos) return ".";
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+bool fileExists(const string& path) {
+    ifstream file(path, ios::binary);
+    return file.good();
+}
+
+// Imports a CSV or JSON lines feed. The file is mapped and cut into chunks at
+// line boundaries; worker threads claim chunks and parse and validate them
+// with the same rules as interactive entry. IDs are then reserved for all
+// accepted rows as one block and handed out in file order. A feed that is
+// large next to the catalog rebuilds every index in one bulk load and is
+// made durable by a snapshot; a small one goes through addProduct and the
+// mutation log. Either way stats.saved says whether the products reached the
+// disk; without an open log neither branch saves. threads <= 0 uses one per
+// hardware thread.
+bool importProductsFromFile(const string& filename, int threads, ImportStats& stats) {
+    stats = ImportStats();
+    auto start = chrono::steady_clock::now();
+    MappedFile file;
+    if (!mapFile(filename, file)) {
+        cerr << "Error: Could not open import file: " << filename << endl;
+        return false;
+    }
+    const char* data = file.data;
+    const char* end = file.data + file.size;
+    if (end - data >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) data += 3;
+
+    ImportFormat format = IMPORT_CSV;
+    size_t dot = filename.find_last_of('.');
+    string extension = dot == string::npos ? "" : filename.substr(dot);
+    const char* first = data;
+    while (first < end && isspace(static_cast<unsigned char>(*first))) ++first;
+    if (extension == ".jsonl" || extension == ".json" || extension == ".ndjson" || (first < end && *first == '{')) {
+        format = IMPORT_JSONL;
+    }
+
+    // A CSV header names the columns; without one they are taken in order
+    int columns[4] = {0, 1, 2, 3};
+    if (format == IMPORT_CSV && data < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(data, '\n', end - data));
+        if (lineEnd == nullptr) lineEnd = end;
+        vector<string> header;
+        splitCSVLine(data, lineEnd > data && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd, header);
+        const char* names[4] = {"name", "category", "price", "rating"};
+        bool isHeader = false;
+        for (int k = 0; k < 4; ++k) {
+            columns[k] = -1;
+            for (size_t f = 0; f < header.size(); ++f) {
+                string field = header[f];
+                field.erase(remove_if(field.begin(), field.end(), [](char c) { return isspace(static_cast<unsigned char>(c)); }), field.end());
+                transform(field.begin(), field.end(), field.begin(), [](char c) { return tolower(static_cast<unsigned char>(c)); });
+                if (field == names[k]) columns[k] = f;
+            }
+            isHeader = isHeader || columns[k] >= 0;
+        }
+        if (isHeader) {
+            for (int k = 0; k < 4; ++k) {
+                if (columns[k] < 0) {
+                    cerr << "Error: " << filename << " has no \"" << names[k] << "\" column." << endl;
+                    unmapFile(file);
+                    return false;
+                }
+            }
+            data = lineEnd < end ? lineEnd + 1 : end;
+        } else {
+            for (int k = 0; k < 4; ++k) columns[k] = k;
+        }
+    }
+
+    if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+    threads = min(threads, 64);
+    stats.threads = threads;
+
+    // Several chunks per thread, so a slow chunk does not leave others idle
+    vector<ImportChunk> chunks;
+    size_t chunkCount = static_cast<size_t>(threads) * 4;
+    const char* cursor = data;
+    for (size_t i = 1; i <= chunkCount && cursor < end; ++i) {
+        const char* target = max(cursor, data + (end - data) * i / chunkCount);
+        const char* newline = target < end ? static_cast<const char*>(memchr(target, '\n', end - target)) : nullptr;
+        const char* chunkEnd = newline == nullptr ? end : newline + 1;
+        ImportChunk chunk;
+        chunk.begin = cursor;
+        chunk.end = chunkEnd;
+        chunk.rows = 0;
+        chunk.rejected = 0;
+        chunks.push_back(chunk);
+        cursor = chunkEnd;
+    }
+
+    atomic<size_t> nextChunk(0);
+    auto worker = [&]() {
+        for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+            parseImportChunk(chunks[i], format, columns);
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (thread& t : pool) {
+        t.join();
+    }
+    unmapFile(file);
+    stats.parseMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    size_t accepted = 0;
+    for (const ImportChunk& chunk : chunks) {
+        stats.rows += chunk.rows;
+        stats.rejected += chunk.rejected;
+        accepted += chunk.products.size();
+    }
+    vector<Product> imported;
+    imported.reserve(accepted);
+    int id = reserveProductIDs(accepted);
+    for (ImportChunk& chunk : chunks) {
+        vector<int> codes(chunk.categories.size());
+        for (size_t c = 0; c < codes.size(); ++c) {
+            codes[c] = internCategory(chunk.categories[c]);
+        }
+        for (Product& product : chunk.products) {
+            product.id = id++;
+            product.categoryCode = codes[product.categoryCode];
+            imported.push_back(move(product));
+        }
+        vector<Product>().swap(chunk.products);
+    }
+    stats.imported = imported.size();
+    stats.rebuildRows = idView.size() / IMPORT_REBUILD_SHARE;
+    if (imported.empty()) return true;
+
+    stats.rebuilt = imported.size() >= stats.rebuildRows;
+    if (stats.rebuilt) {
+        // New IDs are above every existing one, so appending keeps ID order
+        vector<Product> all;
+        all.reserve(idView.size() + imported.size());
+        for (int slot : idView) {
+            all.push_back(productAt(slot));
+        }
+        move(imported.begin(), imported.end(), back_inserter(all));
+        bulkLoadProducts(all);
+        stats.insertMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        stats.saved = mutationLog.file != nullptr && compactCatalog(true);
+        stats.saveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    } else {
+        for (const Product& product : imported) {
+            addProduct(product);
+        }
+        stats.insertMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        stats.saved = mutationLog.file != nullptr && syncMutationLog();
+        stats.saveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
+
+// Worker body: parses every line of one chunk into chunk.products. Blank
+// lines are skipped; a line that does not parse or breaks a rule of
+// readProductDetails is counted in chunk.rejected.
+void parseImportChunk(ImportChunk& chunk, ImportFormat format, const int* columns) {
+    unordered_map<string, int> localCodes;
+    vector<string> fields;
+    string values[4];       // name, category, price, rating
+    int lastColumn = max(max(columns[0], columns[1]), max(columns[2], columns[3]));
+
+    const char* line = chunk.begin;
+    while (line < chunk.end) {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', chunk.end - line));
+        if (lineEnd == nullptr) lineEnd = chunk.end;
+        const char* next = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+        if (lineEnd > line && lineEnd[-1] == '\r') --lineEnd;
+
+        bool blank = true;
+        for (const char* c = line; c < lineEnd && blank; ++c) {
+            blank = isspace(static_cast<unsigned char>(*c)) != 0;
+        }
+        if (!blank) {
+            ++chunk.rows;
+            bool parsed;
+            if (format == IMPORT_CSV) {
+                parsed = splitCSVLine(line, lineEnd, fields) && static_cast<int>(fields.size()) > lastColumn;
+                for (int k = 0; k < 4 && parsed; ++k) {
+                    values[k].swap(fields[columns[k]]);
+                }
+            } else {
+                parsed = parseJSONLine(line, lineEnd, values);
+            }
+
+            Product product;
+            if (parsed && isValidNameOrCategory(values[0]) && isValidNameOrCategory(values[1]) &&
+                parseNumberField(values[2], product.price) && product.price >= 0 &&
+                parseNumberField(values[3], product.rating) && product.rating >= 1.0f && product.rating <= 5.0f) {
+                auto code = localCodes.find(values[1]);
+                if (code == localCodes.end()) {
+                    code = localCodes.emplace(values[1], static_cast<int>(chunk.categories.size())).first;
+                    chunk.categories.push_back(values[1]);
+                }
+                product.id = 0;
+                product.name.swap(values[0]);
+                product.categoryCode = code->second;
+                chunk.products.push_back(move(product));
+            } else {
+                ++chunk.rejected;
+            }
+        }
+        line = next;
+    }
+}
+
+// Splits one CSV line into fields. Quoted fields keep their text verbatim
+// with "" standing for a quote; unquoted fields are trimmed. Returns false
+// for a quote that is never closed or is followed by more text.
+bool splitCSVLine(const char* begin, const char* end, vector<string>& fields) {
+    fields.clear();
+    const char* p = begin;
+    while (true) {
+        string field;
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        if (p < end && *p == '"') {
+            ++p;
+            while (true) {
+                if (p >= end) return false;
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') {
+                        field += '"';
+                        p += 2;
+                        continue;
+                    }
+                    ++p;
+                    break;
+                }
+                field += *p++;
+            }
+            while (p < end && (*p == ' ' || *p == '\t')) ++p;
+            if (p < end && *p != ',') return false;
+        } else {
+            const char* fieldEnd = static_cast<const char*>(memchr(p, ',', end - p));
+            if (fieldEnd == nullptr) fieldEnd = end;
+            const char* last = fieldEnd;
+            while (last > p && (last[-1] == ' ' || last[-1] == '\t')) --last;
+            field.assign(p, last);
+            p = fieldEnd;
+        }
+        fields.push_back(field);
+        if (p >= end) return true;
+        ++p;    // the comma
+    }
+}
+
+// Reads one JSON object and stores the text of its name, category, price and
+// rating members in values (numbers may also be given as strings). Other
+// members are skipped if they are scalars; nested objects and arrays, and
+// escapes outside ASCII, make the line invalid.
+bool parseJSONLine(const char* begin, const char* end, string* values) {
+    static const char* keys[4] = {"name", "category", "price", "rating"};
+    for (int k = 0; k < 4; ++k) values[k].clear();
+
+    const char* p = begin;
+    auto skipSpace = [&p, end]() {
+        while (p < end && isspace(static_cast<unsigned char>(*p))) ++p;
+    };
+    auto readString = [&p, end](string& out) {
+        out.clear();
+        if (p >= end || *p != '"') return false;
+        for (++p; p < end && *p != '"'; ++p) {
+            if (*p != '\\') {
+                out += *p;
+                continue;
+            }
+            if (++p >= end) return false;
+            switch (*p) {
+                case '"': case '\\': case '/': out += *p; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    if (end - p < 5) return false;
+                    unsigned code = 0;
+                    for (int i = 1; i <= 4; ++i) {
+                        char h = p[i];
+                        if (!isxdigit(static_cast<unsigned char>(h))) return false;
+                        code = code * 16 + (isdigit(static_cast<unsigned char>(h)) ? h - '0' : (tolower(h) - 'a' + 10));
+                    }
+                    if (code >= 0x80) return false;
+                    out += static_cast<char>(code);
+                    p += 4;
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        if (p >= end) return false;
+        ++p;    // closing quote
+        return true;
+    };
+
+    skipSpace();
+    if (p >= end || *p != '{') return false;
+    ++p;
+    skipSpace();
+    if (p < end && *p == '}') return true;
+    string key, value;
+    while (true) {
+        skipSpace();
+        if (!readString(key)) return false;
+        skipSpace();
+        if (p >= end || *p != ':') return false;
+        ++p;
+        skipSpace();
+        if (p < end && *p == '"') {
+            if (!readString(value)) return false;
+        } else {
+            const char* token = p;
+            while (p < end && *p != ',' && *p != '}' && !isspace(static_cast<unsigned char>(*p))) {
+                if (*p == '{' || *p == '[') return false;
+                ++p;
+            }
+            if (p == token) return false;
+            value.assign(token, p);
+        }
+        for (int k = 0; k < 4; ++k) {
+            if (key == keys[k]) values[k] = value;
+        }
+        skipSpace();
+        if (p < end && *p == ',') {
+            ++p;
+            continue;
+        }
+        if (p < end && *p == '}') break;
+        return false;
+    }
+    ++p;
+    skipSpace();
+    return p == end;
+}
+
+// Parses a whole field as a finite number; surrounding spaces are allowed
+bool parseNumberField(const string& text, float& value) {
+    const char* begin = text.c_str();
+    char* stop = nullptr;
+    value = strtof(begin, &stop);
+    if (stop == begin) return false;
+    while (*stop != '\0' && isspace(static_cast<unsigned char>(*stop))) ++stop;
+    return *stop == '\0' && std::isfinite(value);
+}
+
+// Accepts "PID07", "pid7" or a bare "7"; returns -1 when no valid number is present
+int parseProductID(const string& input) {
+    size_t pos = 0;
+    if (input.size() >= 3 && toupper(input[0]) == 'P' && toupper(input[1]) == 'I' && toupper(input[2]) == 'D') {
+        pos = 3;
+    }
+    if (pos == input.size()) return -1;
+
+    long number = 0;
+    for (; pos < input.size(); ++pos) {
+        if (!isdigit(static_cast<unsigned char>(input[pos]))) return -1;
+        number = number * 10 + (input[pos] - '0');
+        if (number > numeric_limits<int>::max()) return -1;
+    }
+    return static_cast<int>(number);
+}
+
+// Searches the ID view and returns the position of the product's slot in it
+int binarySearchByID(const vector<int>& view, int targetID) {
+    int low = 0;
+    int high = view.size() - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int midID = columns.id[view[mid]];
+
+        if (midID == targetID) {
+            return mid;
+        } 
+        else if (midID < targetID) {
+            low = mid + 1;
+        } 
+        else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+// Splits a name into lowercase alphanumeric words
+vector<string> tokenizeName(const string& name) {
+    vector<string> tokens;
+    string token;
+    size_t pos = 0;
+    while (nextNameToken(name, pos, token)) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+// Reads the word starting at or after pos into token (lowercased) and moves
+// pos past it; false once no word is left. Filling the caller's string keeps
+// its capacity, so a loop over many names stops allocating after the first few.
+bool nextNameToken(const string& name, size_t& pos, string& token) {
+    while (pos < name.size() && !isalnum(static_cast<unsigned char>(name[pos]))) pos++;
+    if (pos == name.size()) return false;
+    token.clear();
+    while (pos < name.size() && isalnum(static_cast<unsigned char>(name[pos]))) {
+        token += static_cast<char>(tolower(static_cast<unsigned char>(name[pos++])));
+    }
+    return true;
+}
+
+// Adds a product to both name indexes (word tokens and trigrams). The token
+// and trigram buffers are reused, so only a new token or a posting list that
+// outgrows its capacity allocates; a bulk load indexes a million names with
+// amortised O(1) allocations per product.
+void indexProductName(int id, int slot, const string& name) {
+    // One pair of buffers per thread: the function keeps no state shared
+    // between threads, although the indexes themselves still have one writer
+    static thread_local string token;
+    static thread_local vector<uint32_t> grams;
+    TokenIndex& tokens = writableNameIndex();
+    TrigramIndex& trigrams = writableTrigramIndex();
+    size_t pos = 0;
+    while (nextNameToken(name, pos, token)) {
+        vector<int>& postings = tokens[token];
+        // New products have the highest IDs, so this is almost always an append
+        auto at = lower_bound(postings.begin(), postings.end(), id);
+        if (at == postings.end() || *at != id) {
+            postings.insert(at, id);
+        }
+    }
+    nameTrigrams(name, grams);
+    for (uint32_t gram : grams) {
+        vector<int>& postings = trigrams[gram];
+        auto at = lower_bound(postings.begin(), postings.end(), slot);
+        if (at == postings.end() || *at != slot) {
+            postings.insert(at, slot);
+        }
+    }
+}
+
+void unindexProductName(int id, int slot, const string& name) {
+    TokenIndex& tokens = writableNameIndex();
+    TrigramIndex& trigrams = writableTrigramIndex();
+    for (const string& token : tokenizeName(name)) {
+        auto entry = tokens.find(token);
+        if (entry == tokens.end()) continue;
+
+        vector<int>& postings = entry->second;
+        auto pos = lower_bound(postings.begin(), postings.end(), id);
+        if (pos != postings.end() && *pos == id) {
+            postings.erase(pos);
+        }
+        if (postings.empty()) {
+            tokens.erase(entry);
+        }
+    }
+    for (uint32_t gram : nameTrigrams(name)) {
+        auto entry = trigrams.find(gram);
+        if (entry == trigrams.end()) continue;
+
+        vector<int>& postings = entry->second;
+        auto pos = lower_bound(postings.begin(), postings.end(), slot);
+        if (pos != postings.end() && *pos == slot) {
+            postings.erase(pos);
+        }
+        if (postings.empty()) {
+            trigrams.erase(entry);
+        }
+    }
+}
+
+// Distinct lowercase trigrams of a string, each packed into the low 24 bits
+vector<uint32_t> nameTrigrams(const string& text) {
+    vector<uint32_t> grams;
+    nameTrigrams(text, grams);
+    return grams;
+}
+
+void nameTrigrams(const string& text, vector<uint32_t>& grams) {
+    grams.clear();
+    if (text.size() < 3) return;
+
+    uint32_t gram = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        uint32_t c = static_cast<unsigned char>(tolower(static_cast<unsigned char>(text[i])));
+        gram = ((gram << 8) | c) & 0xFFFFFF;
+        if (i >= 2) grams.push_back(gram);
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+}
+
+bool containsIgnoreCase(const string& text, const string& lowerNeedle) {
+    return containsIgnoreCase(text.data(), text.size(), lowerNeedle);
+}
+
+bool containsIgnoreCase(const char* text, size_t length, const string& lowerNeedle) {
+    // Lowercasing into a reused buffer lets string::find do the matching,
+    // which is several times faster than std::search with a folding predicate
+    static thread_local string lowered;
+    lowered.resize(length);
+    for (size_t i = 0; i < length; ++i) {
+        lowered[i] = static_cast<char>(tolower(static_cast<unsigned char>(text[i])));
+    }
+    return lowered.find(lowerNeedle) != string::npos;
+}
+
+// Collects the posting list of every trigram, shortest first. Returns false
+// if some trigram occurs in no name, in which case nothing can match.
+bool trigramPostingLists(const TrigramIndex& index, const vector<uint32_t>& grams,
+                         vector<const vector<int>*>& lists) {
+    lists.clear();
+    for (uint32_t gram : grams) {
+        auto entry = index.find(gram);
+        if (entry == index.end()) return false;
+        lists.push_back(&entry->second);
+    }
+    sort(lists.begin(), lists.end(),
+        [](const vector<int>* a, const vector<int>* b) { return a->size() < b->size(); });
+    return true;
+}
+
+// Narrows slot-sorted candidates to those present in lists[first..]. Each
+// list is searched by galloping forward from the previous match, so a pass
+// costs O(c log(L/c)) for c candidates and list length L: close to a merge when
+// the sizes are similar, close to c binary searches when the list is much
+// longer. Callers verify the survivors anyway, so intersecting stops once only
+// a handful of candidates remain.
+void intersectSlotLists(vector<int>& candidates, const vector<const vector<int>*>& lists, size_t first) {
+    for (size_t i = first; i < lists.size() && candidates.size() > 32; ++i) {
+        const vector<int>& list = *lists[i];
+        size_t kept = 0;
+        size_t pos = 0;
+        for (int slot : candidates) {
+            size_t step = 1;
+            while (pos + step < list.size() && list[pos + step] < slot) step *= 2;
+            pos = lower_bound(list.begin() + pos + step / 2, list.begin() + min(pos + step + 1, list.size()), slot)
+                  - list.begin();
+            if (pos == list.size()) break;
+            if (list[pos] == slot) candidates[kept++] = slot;
+        }
+        candidates.resize(kept);
+    }
+}
+
+// Case-insensitive substring search. Candidates are the products holding
+// every trigram of the query; each is then verified against the name, since
+// sharing all trigrams does not guarantee they appear contiguously. Queries
+// shorter than three characters have no trigrams and are checked directly.
+vector<int> substringSearchNames(const string& query) {
+    return substringSearchNames(liveNameSource(), query);
+}
+
+vector<int> substringSearchNames(const NameSearchSource& source, const string& query) {
+    const vector<int>& ids = *source.ids;
+    const vector<NameSpan>& names = *source.names;
+    string needle;
+    for (char c : query) {
+        needle += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+
+    vector<int> result;
+    vector<uint32_t> grams = nameTrigrams(needle);
+    if (grams.empty()) {
+        for (int slot : *source.idView) {
+            if (containsIgnoreCase(source.nameArena + names[slot].offset, names[slot].length, needle)) {
+                result.push_back(ids[slot]);
+            }
+        }
+        return result;
+    }
+
+    vector<const vector<int>*> lists;
+    if (!trigramPostingLists(*source.trigrams, grams, lists)) return result;
+
+    vector<int> candidates = *lists[0];
+    intersectSlotLists(candidates, lists, 1);
+
+    // A three-character query is its own trigram, so every candidate matches.
+    // A longer one can still reduce to a single trigram ("aaaa" to "aaa").
+    for (int slot : candidates) {
+        if (needle.size() == 3 ||
+            containsIgnoreCase(source.nameArena + names[slot].offset, names[slot].length, needle)) {
+            result.push_back(ids[slot]);
+        }
+    }
+    // Slot order follows ID order unless removed slots have been reused
+    if (!is_sorted(result.begin(), result.end())) {
+        sort(result.begin(), result.end());
+    }
+    return result;
+}
+
+// Levenshtein distance between a and b, or maxEdits + 1 as soon as it is
+// known to exceed maxEdits
+int boundedEditDistance(const string& a, const string& b, int maxEdits) {
+    int lengthGap = static_cast<int>(a.size()) - static_cast<int>(b.size());
+    if (abs(lengthGap) > maxEdits) return maxEdits + 1;
+
+    vector<int> previous(b.size() + 1), current(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) previous[j] = j;
+
+    for (size_t i = 1; i <= a.size(); ++i) {
+        current[0] = i;
+        int rowMin = current[0];
+        for (size_t j = 1; j <= b.size(); ++j) {
+            int substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            current[j] = min(substitution, min(previous[j], current[j - 1]) + 1);
+            rowMin = min(rowMin, current[j]);
+        }
+        if (rowMin > maxEdits) return maxEdits + 1;
+        previous.swap(current);
+    }
+    return min(previous[b.size()], maxEdits + 1);
+}
+
+// Typo-tolerant search: every query word must be within a few edits of some
+// word in the name (0 edits for words of 1-2 letters, 1 for 3-5, otherwise
+// up to maxEdits). Only the distinct tokens of nameIndex are compared, not
+// every product, and the postings of the accepted tokens are intersected.
+vector<int> fuzzySearchNames(const string& query, int maxEdits) {
+    return fuzzySearchNames(liveNameSource(), query, maxEdits);
+}
+
+vector<int> fuzzySearchNames(const NameSearchSource& source, const string& query, int maxEdits) {
+    vector<string> words = tokenizeName(query);
+    if (words.empty()) return vector<int>();
+
+    vector<vector<int>> lists;
+    for (const string& word : words) {
+        int allowed = word.size() <= 2 ? 0 : (word.size() <= 5 ? min(1, maxEdits) : maxEdits);
+        vector<int> postings;
+        for (const auto& entry : *source.tokens) {
+            if (boundedEditDistance(word, entry.first, allowed) <= allowed) {
+                postings.insert(postings.end(), entry.second.begin(), entry.second.end());
+            }
+        }
+        if (postings.empty()) return vector<int>();
+
+        sort(postings.begin(), postings.end());
+        postings.erase(unique(postings.begin(), postings.end()), postings.end());
+        lists.push_back(postings);
+    }
+
+    sort(lists.begin(), lists.end(),
+        [](const vector<int>& a, const vector<int>& b) { return a.size() < b.size(); });
+
+    vector<int> result = lists[0];
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        vector<int> narrowed;
+        set_intersection(result.begin(), result.end(), lists[i].begin(), lists[i].end(),
+                         back_inserter(narrowed));
+        result.swap(narrowed);
+    }
+    return result;
+}
+
+// Every query word is matched as a prefix of some word in the name, so
+// "wire mou" finds "Wireless Mouse". The postings of each query word are
+// gathered, then intersected starting from the shortest list. Returns
+// matching product IDs in ascending order.
+vector<int> searchNameIndex(const string& query) {
+    return searchNameIndex(liveNameSource(), query);
+}
+
+vector<int> searchNameIndex(const NameSearchSource& source, const string& query) {
+    vector<string> words = tokenizeName(query);
+    if (words.empty()) {
+        vector<int> all;
+        all.reserve(source.idView->size());
+        for (int slot : *source.idView) {
+            all.push_back((*source.ids)[slot]);
+        }
+        return all;
+    }
+
+    vector<vector<int>> lists;
+    for (const string& word : words) {
+        vector<int> postings;
+        int tokensMatched = 0;
+        for (auto it = source.tokens->lower_bound(word);
+             it != source.tokens->end() && it->first.compare(0, word.size(), word) == 0; ++it) {
+            postings.insert(postings.end(), it->second.begin(), it->second.end());
+            tokensMatched++;
+        }
+        if (postings.empty()) return vector<int>();
+
+        // A prefix shared by several words needs its postings merged
+        if (tokensMatched > 1) {
+            sort(postings.begin(), postings.end());
+            postings.erase(unique(postings.begin(), postings.end()), postings.end());
+        }
+        lists.push_back(postings);
+    }
+
+    sort(lists.begin(), lists.end(),
+        [](const vector<int>& a, const vector<int>& b) { return a.size() < b.size(); });
+
+    vector<int> result = lists[0];
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        vector<int> narrowed;
+        set_intersection(result.begin(), result.end(), lists[i].begin(), lists[i].end(),
+                         back_inserter(narrowed));
+        result.swap(narrowed);
+    }
+    return result;
+}
+
+// The cascade behind searchByName and the name command: substring matches,
+// then word prefixes, then typo-tolerant words. Returns the matching IDs in
+// ascending order; match names the mode that found them, or "none".
+vector<int> cascadeNameSearch(const NameSearchSource& source, const string& query, const char*& match) {
+    match = "substring";
+    vector<int> ids = substringSearchNames(source, query);
+    if (ids.empty()) {
+        match = "words";
+        ids = searchNameIndex(source, query);
+    }
+    if (ids.empty()) {
+        match = "fuzzy";
+        ids = fuzzySearchNames(source, query, 2);
+    }
+    if (ids.empty()) match = "none";
+    return ids;
+}
+
+NameSearchSource liveNameSource() {
+    return NameSearchSource{nameIndex.get(), trigramIndex.get(), &idView, &columns.id, &columns.name,
+                            columns.nameArena.data()};
+}
+
+NameSearchSource snapshotNameSource(const CatalogSnapshot& snapshot) {
+    return NameSearchSource{snapshot.nameIndex.get(), snapshot.trigramIndex.get(), snapshot.views[SORT_BY_ID].get(),
+                            snapshot.id.get(), snapshot.name.get(), snapshot.nameArena->data()};
+}
+
+// The live name indexes, copied first if a snapshot still shares them. The
+// copy costs O(index size), once per publish that is followed by a name change.
+TokenIndex& writableNameIndex() {
+    if (nameIndex.use_count() > 1) nameIndex = make_shared<TokenIndex>(*nameIndex);
+    return *nameIndex;
+}
+
+TrigramIndex& writableTrigramIndex() {
+    if (trigramIndex.use_count() > 1) trigramIndex = make_shared<TrigramIndex>(*trigramIndex);
+    return *trigramIndex;
+}
+
+// Returns the code for a category, adding it to the dictionary if it is new
+int internCategory(const string& category) {
+    auto entry = categoryCodes.find(category);
+    if (entry != categoryCodes.end()) return entry->second;
+
+    int code = categoryNames.size();
+    categoryNames.push_back(category);
+    categoryCodes[category] = code;
+    categoryPostings.push_back(vector<int>());
+    snapshotStale |= SNAPSHOT_CATEGORIES;
+    return code;
+}
+
+// Returns the code for a category, or -1 if no product has ever used it
+int findCategory(const string& category) {
+    auto entry = categoryCodes.find(category);
+    return entry == categoryCodes.end() ? -1 : entry->second;
+}
+
+const string& categoryName(int code) {
+    return categoryNames[code];
+}
+
+// Adds the product in this slot to its category's posting list, keeping
+// ID order (new products have the highest IDs, so this is usually an append)
+void indexProductCategory(int slot) {
+    vector<int>& postings = categoryPostings[columns.categoryCode[slot]];
+    auto pos = lower_bound(postings.begin(), postings.end(), columns.id[slot],
+        [](int s, int id) { return columns.id[s] < id; });
+    postings.insert(pos, slot);
+}
+
+// Reads the slot's columns, so during an update it must run before storeColumns
+void unindexProductCategory(int slot) {
+    vector<int>& postings = categoryPostings[columns.categoryCode[slot]];
+    auto pos = lower_bound(postings.begin(), postings.end(), columns.id[slot],
+        [](int s, int id) { return columns.id[s] < id; });
+    if (pos != postings.end() && *pos == slot) {
+        postings.erase(pos);
+    }
+}
+
+// Range index over the price or rating view: two binary searches give the
+// half-open run [first, second) of view positions whose value is in [low, high].
+pair<int, int> viewRange(SortKey key, float low, float high) {
+    const vector<int>& view = sortedViews[key];
+    const vector<float>& column = key == SORT_BY_PRICE ? columns.price : columns.rating;
+    auto value = [&column](int slot) { return column[slot]; };
+    
+    auto first = lower_bound(view.begin(), view.end(), low,
+        [&value](int slot, float bound) { return value(slot) < bound; });
+    auto last = upper_bound(first, view.end(), high,
+        [&value](float bound, int slot) { return bound < value(slot); });
+    return make_pair(static_cast<int>(first - view.begin()), static_cast<int>(last - view.begin()));
+}
+
+// Filter kernels. The scalar versions are the reference and handle the
+// partial last word for the vector versions. Each vector version compares a
+// register of values against both bounds and packs the lane results with
+// movemask, eight (AVX2) or four (SSE2) bits at a time.
+void rangeMaskScalar(const float* values, size_t count, float low, float high, uint64_t* mask) {
+    for (size_t word = 0; word * 64 < count; ++word) {
+        size_t first = word * 64;
+        size_t end = min(count, first + 64);
+        uint64_t bits = 0;
+        for (size_t i = first; i < end; ++i) {
+            bits |= static_cast<uint64_t>((values[i] >= low) & (values[i] <= high)) << (i - first);
+        }
+        mask[word] = bits;
+    }
+}
+
+void equalMaskScalar(const int* values, size_t count, int target, uint64_t* mask) {
+    for (size_t word = 0; word * 64 < count; ++word) {
+        size_t first = word * 64;
+        size_t end = min(count, first + 64);
+        uint64_t bits = 0;
+        for (size_t i = first; i < end; ++i) {
+            bits |= static_cast<uint64_t>(values[i] == target) << (i - first);
+        }
+        mask[word] = bits;
+    }
+}
+
+#ifdef FILTER_KERNELS_X86
+__attribute__((target("sse2")))
+void rangeMaskSSE2(const float* values, size_t count, float low, float high, uint64_t* mask) {
+    const __m128 lowBound = _mm_set1_ps(low);
+    const __m128 highBound = _mm_set1_ps(high);
+    size_t words = count / 64;
+    for (size_t word = 0; word < words; ++word) {
+        const float* block = values + word * 64;
+        uint64_t bits = 0;
+        for (int lane = 0; lane < 16; ++lane) {
+            __m128 v = _mm_loadu_ps(block + lane * 4);
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(v, lowBound), _mm_cmple_ps(v, highBound));
+            bits |= static_cast<uint64_t>(_mm_movemask_ps(inside)) << (lane * 4);
+        }
+        mask[word] = bits;
+    }
+    if (count % 64 != 0) rangeMaskScalar(values + words * 64, count % 64, low, high, mask + words);
+}
+
+__attribute__((target("sse2")))
+void equalMaskSSE2(const int* values, size_t count, int target, uint64_t* mask) {
+    const __m128i wanted = _mm_set1_epi32(target);
+    size_t words = count / 64;
+    for (size_t word = 0; word < words; ++word) {
+        const int* block = values + word * 64;
+        uint64_t bits = 0;
+        for (int lane = 0; lane < 16; ++lane) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + lane * 4));
+            __m128 equal = _mm_castsi128_ps(_mm_cmpeq_epi32(v, wanted));
+            bits |= static_cast<uint64_t>(_mm_movemask_ps(equal)) << (lane * 4);
+        }
+        mask[word] = bits;
+    }
+    if (count % 64 != 0) equalMaskScalar(values + words * 64, count % 64, target, mask + words);
+}
+
+__attribute__((target("avx2")))
+void rangeMaskAVX2(const float* values, size_t count, float low, float high, uint64_t* mask) {
+    const __m256 lowBound = _mm256_set1_ps(low);
+    const __m256 highBound = _mm256_set1_ps(high);
+    size_t words = count / 64;
+    for (size_t word = 0; word < words; ++word) {
+        const float* block = values + word * 64;
+        uint64_t bits = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            __m256 v = _mm256_loadu_ps(block + lane * 8);
+            // Ordered comparisons, so NaN (a free slot) is never inside
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(v, lowBound, _CMP_GE_OQ),
+                                          _mm256_cmp_ps(v, highBound, _CMP_LE_OQ));
+            bits |= static_cast<uint64_t>(_mm256_movemask_ps(inside)) << (lane * 8);
+        }
+        mask[word] = bits;
+    }
+    if (count % 64 != 0) rangeMaskScalar(values + words * 64, count % 64, low, high, mask + words);
+}
+
+__attribute__((target("avx2")))
+void equalMaskAVX2(const int* values, size_t count, int target, uint64_t* mask) {
+    const __m256i wanted = _mm256_set1_epi32(target);
+    size_t words = count / 64;
+    for (size_t word = 0; word < words; ++word) {
+        const int* block = values + word * 64;
+        uint64_t bits = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + lane * 8));
+            __m256 equal = _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, wanted));
+            bits |= static_cast<uint64_t>(_mm256_movemask_ps(equal)) << (lane * 8);
+        }
+        mask[word] = bits;
+    }
+    if (count % 64 != 0) equalMaskScalar(values + words * 64, count % 64, target, mask + words);
+}
+#endif
+
+// Every kernel set this CPU can run, narrowest first
+vector<FilterKernels> supportedFilterKernels() {
+    vector<FilterKernels> sets;
+    sets.push_back(FilterKernels{"scalar", rangeMaskScalar, equalMaskScalar});
+#ifdef FILTER_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        sets.push_back(FilterKernels{"SSE2", rangeMaskSSE2, equalMaskSSE2});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        sets.push_back(FilterKernels{"AVX2", rangeMaskAVX2, equalMaskAVX2});
+    }
+#endif
+    return sets;
+}
+
+// The widest kernel set this CPU supports, chosen on first use
+const FilterKernels& activeFilterKernels() {
+    static const FilterKernels widest = supportedFilterKernels().back();
+    return widest;
+}
+
+void andMask(uint64_t* into, const uint64_t* mask, size_t words) {
+    for (size_t word = 0; word < words; ++word) {
+        into[word] &= mask[word];
+    }
+}
+
+size_t countMask(const uint64_t* mask, size_t words) {
+    size_t count = 0;
+    for (size_t word = 0; word < words; ++word) {
+        count += bitset<64>(mask[word]).count();
+    }
+    return count;
+}
+
+// Appends the set bits as slot numbers, in slot order
+void maskToSlots(const uint64_t* mask, size_t words, vector<int>& slots) {
+    for (size_t word = 0; word < words; ++word) {
+        for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+#ifdef __GNUC__
+            int bit = __builtin_ctzll(bits);
+#else
+            int bit = 0;
+            while (((bits >> bit) & 1) == 0) ++bit;
+#endif
+            slots.push_back(static_cast<int>(word * 64 + bit));
+        }
+    }
+}
+
+// Applies the category, price and rating predicates of the query to every
+// slot at once: one bitmap per predicate from the filter kernels, ANDed
+// together. Returns the matching slots in slot order. code is the query's
+// category code, or -1 when it has no category; at least one of the three
+// predicates must be set, since free slots are only excluded by failing one.
+vector<int> scanAttributeColumns(const ProductQuery& query, int code) {
+    const FilterKernels& kernels = activeFilterKernels();
+    size_t count = columns.id.size();
+    size_t words = (count + 63) / 64;
+    vector<uint64_t> selected(words, ~0ULL);
+    vector<uint64_t> mask(words);
+    if (code >= 0) {
+        kernels.equalMask(columns.categoryCode.data(), count, code, mask.data());
+        andMask(selected.data(), mask.data(), words);
+    }
+    if (query.hasPriceRange) {
+        kernels.rangeMask(columns.price.data(), count, query.minPrice, query.maxPrice, mask.data());
+        andMask(selected.data(), mask.data(), words);
+    }
+    if (query.hasRatingRange) {
+        kernels.rangeMask(columns.rating.data(), count, query.minRating, query.maxRating, mask.data());
+        andMask(selected.data(), mask.data(), words);
+    }
+    vector<int> slots;
+    slots.reserve(countMask(selected.data(), words));
+    maskToSlots(selected.data(), words, slots);
+    return slots;
+}
+
+// Sizes the candidate list each set predicate would produce, cheapest first.
+// Every figure comes from an index: a posting list length, the width of a
+// viewRange run, or the shortest trigram list of the name.
+vector<PredicateEstimate> estimateSelectivity(const ProductQuery& query) {
+    vector<PredicateEstimate> plan;
+    if (!query.category.empty()) {
+        int code = findCategory(query.category);
+        size_t count = code < 0 ? 0 : categoryPostings[code].size();
+        plan.push_back(PredicateEstimate{SOURCE_CATEGORY, count});
+    }
+    if (query.hasPriceRange) {
+        pair<int, int> range = viewRange(SORT_BY_PRICE, query.minPrice, query.maxPrice);
+        plan.push_back(PredicateEstimate{SOURCE_PRICE, static_cast<size_t>(max(0, range.second - range.first))});
+    }
+    if (query.hasRatingRange) {
+        pair<int, int> range = viewRange(SORT_BY_RATING, query.minRating, query.maxRating);
+        plan.push_back(PredicateEstimate{SOURCE_RATING, static_cast<size_t>(max(0, range.second - range.first))});
+    }
+    if (!query.nameContains.empty()) {
+        vector<const vector<int>*> lists;
+        vector<uint32_t> grams = nameTrigrams(query.nameContains);
+        size_t count = idView.size();
+        if (!grams.empty()) {
+            count = trigramPostingLists(*trigramIndex, grams, lists) ? lists[0]->size() : 0;
+        }
+        plan.push_back(PredicateEstimate{SOURCE_NAME, count});
+    }
+    stable_sort(plan.begin(), plan.end(),
+        [](const PredicateEstimate& a, const PredicateEstimate& b) { return a.estimate < b.estimate; });
+    return plan;
+}
+
+// True when runQuery should take its candidates from scanAttributeColumns:
+// with two or more attribute predicates and even the most selective one
+// matching a large share of the catalog, one sequential pass of the filter
+// kernels over the columns beats checking each candidate by random access.
+bool prefersAttributeScan(const ProductQuery& query, const vector<PredicateEstimate>& plan) {
+    int attributePredicates = !query.category.empty() + query.hasPriceRange + query.hasRatingRange;
+    return attributePredicates >= 2 && plan[0].source != SOURCE_NAME &&
+           plan[0].estimate * ATTRIBUTE_SCAN_SHARE > columns.id.size();
+}
+
+// Answers a conjunction of predicates. The most selective predicate supplies
+// the candidates and the rest are checked on each one: category, price and
+// rating first since they are O(1) per product, and the name substring last.
+// Returns slots ordered by query.sortKey.
+vector<int> runQuery(const ProductQuery& query) {
+    vector<PredicateEstimate> plan = estimateSelectivity(query);
+    if (!plan.empty() && plan[0].estimate == 0) return vector<int>();
+
+    // Candidates are read in place from a posting list or view where possible;
+    // only a name driver or the attribute scan builds its own list
+    vector<int> candidates;
+    const int* first = nullptr;
+    const int* last = nullptr;
+    auto borrow = [&first, &last](const vector<int>& list, size_t from, size_t to) {
+        first = list.data() + from;
+        last = list.data() + to;
+    };
+    QuerySource driver = plan.empty() ? SOURCE_ALL : plan[0].source;
+    string needle;
+    for (char c : query.nameContains) {
+        needle += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    vector<const vector<int>*> nameLists;
+    vector<uint32_t> grams = nameTrigrams(needle);
+    if (!grams.empty()) trigramPostingLists(*trigramIndex, grams, nameLists);
+
+    int code = query.category.empty() ? -1 : findCategory(query.category);
+    bool attributeScan = prefersAttributeScan(query, plan);
+    if (attributeScan) {
+        candidates = scanAttributeColumns(query, code);
+        driver = SOURCE_ALL;
+    } else switch (driver) {
+        case SOURCE_CATEGORY:
+            borrow(categoryPostings[code], 0, categoryPostings[code].size());
+            break;
+        case SOURCE_PRICE:
+        case SOURCE_RATING: {
+            SortKey key = driver == SOURCE_PRICE ? SORT_BY_PRICE : SORT_BY_RATING;
+            pair<int, int> range = driver == SOURCE_PRICE
+                ? viewRange(key, query.minPrice, query.maxPrice)
+                : viewRange(key, query.minRating, query.maxRating);
+            borrow(sortedViews[key], range.first, range.second);
+            break;
+        }
+        case SOURCE_NAME:
+            if (nameLists.empty()) candidates = idView;
+            else candidates = *nameLists[0];
+            break;
+        default:
+            borrow(idView, 0, idView.size());
+            break;
+    }
+
+    // A name-only query narrows its candidates with the other trigram lists.
+    // With attribute predicates left, checking them on each product is
+    // cheaper than probing lists at least as long as the candidate set.
+    if (driver == SOURCE_NAME && !nameLists.empty() && plan.size() == 1) {
+        intersectSlotLists(candidates, nameLists, 1);
+    }
+
+    if (first == nullptr) {
+        first = candidates.data();
+        last = first + candidates.size();
+    }
+
+    // Category postings and the ID view are in ID order, and a price or
+    // rating view is in the order of its key. When that is the requested
+    // order, matches come out sorted and the walk stops once the page is full.
+    bool inOrder = !attributeScan &&
+                   (((driver == SOURCE_CATEGORY || driver == SOURCE_ALL) && query.sortKey == SORT_BY_ID) ||
+                    (driver == SOURCE_PRICE && query.sortKey == SORT_BY_PRICE) ||
+                    (driver == SOURCE_RATING && query.sortKey == SORT_BY_RATING));
+    bool backwards = inOrder && !query.ascending;
+    // Only offset + limit results are ever shown, so only those are ordered
+    size_t wanted = query.limit == 0 ? numeric_limits<size_t>::max() : query.offset + query.limit;
+
+    vector<int> result;
+    for (ptrdiff_t i = 0, count = last - first; i < count; ++i) {
+        int slot = backwards ? last[-1 - i] : first[i];
+        if (!attributeScan) {
+            if (code >= 0 && columns.categoryCode[slot] != code) continue;
+            float price = columns.price[slot];
+            if (query.hasPriceRange && (price < query.minPrice || price > query.maxPrice)) continue;
+            float rating = columns.rating[slot];
+            if (query.hasRatingRange && (rating < query.minRating || rating > query.maxRating)) continue;
+        }
+        if (!needle.empty() && !containsIgnoreCase(columnName(slot), columns.name[slot].length, needle)) continue;
+        result.push_back(slot);
+        if (inOrder && result.size() == wanted) break;
+    }
+
+    if (!inOrder) {
+        selectTopSlots(result, query.sortKey, query.ascending, min(result.size(), wanted));
+    }
+
+    result.erase(result.begin(), result.begin() + min(query.offset, result.size()));
+    return result;
+}
+
+// Keeps the first count slots in the order the view for key would list them
+// (read backwards when descending) and drops the rest. A full sort is only
+// done when every slot is wanted; otherwise partial_sort selects the count
+// smallest in O(m log count). The sort key and ID are copied next to each slot
+// first, so comparisons read contiguous data instead of following every slot
+// into the columns. Names are decorated with their first eight bytes packed
+// big-endian, which orders the same way string::compare does; only names
+// sharing that prefix fall back to the full comparison.
+void selectTopSlots(vector<int>& slots, SortKey key, bool ascending, size_t count) {
+    count = min(count, slots.size());
+    if (key == SORT_BY_NAME) {
+        struct NameKeyed { uint64_t prefix; int id; int slot; };
+        vector<NameKeyed> keyed;
+        keyed.reserve(slots.size());
+        for (int slot : slots) {
+            keyed.push_back(NameKeyed{columns.name[slot].prefix, columns.id[slot], slot});
+        }
+        auto nameLess = [](const NameKeyed& a, const NameKeyed& b) {
+            if (a.prefix != b.prefix) return a.prefix < b.prefix;
+            int cmp = compareSlotNames(a.slot, b.slot);
+            return cmp != 0 ? cmp < 0 : a.id < b.id;
+        };
+        auto less = [ascending, &nameLess](const NameKeyed& a, const NameKeyed& b) {
+            return ascending ? nameLess(a, b) : nameLess(b, a);
+        };
+        if (count == keyed.size()) {
+            sort(keyed.begin(), keyed.end(), less);
+        } else {
+            partial_sort(keyed.begin(), keyed.begin() + count, keyed.end(), less);
+        }
+        slots.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            slots[i] = keyed[i].slot;
+        }
+        return;
+    }
+
+    struct Keyed { float value; int id; int slot; };
+    vector<Keyed> keyed;
+    keyed.reserve(slots.size());
+    for (int slot : slots) {
+        float value = key == SORT_BY_PRICE ? columns.price[slot] : (key == SORT_BY_RATING ? columns.rating[slot] : 0.0f);
+        keyed.push_back(Keyed{value, columns.id[slot], slot});
+    }
+    auto less = [ascending](const Keyed& a, const Keyed& b) {
+        if (!ascending) return a.value != b.value ? a.value > b.value : a.id > b.id;
+        return a.value != b.value ? a.value < b.value : a.id < b.id;
+    };
+    if (count == keyed.size()) {
+        sort(keyed.begin(), keyed.end(), less);
+    } else {
+        partial_sort(keyed.begin(), keyed.begin() + count, keyed.end(), less);
+    }
+    slots.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        slots[i] = keyed[i].slot;
+    }
+}
+
+// Ascending order of a view; ties are broken by ID so every product has
+// exactly one position, which lets the views be updated by binary search.
+bool keyLess(SortKey key, const Product& a, const Product& b) {
+    switch (key) {
+        case SORT_BY_PRICE:
+            if (a.price != b.price) return a.price < b.price;
+            break;
+        case SORT_BY_RATING:
+            if (a.rating != b.rating) return a.rating < b.rating;
+            break;
+        case SORT_BY_NAME: {
+            int cmp = a.name.compare(b.name);
+            if (cmp != 0) return cmp < 0;
+            break;
+        }
+        default:
+            break;
+    }
+    return a.id < b.id;
+}
+
+// keyLess for two slots, read from the columns. The views are kept in this order.
+bool slotLess(SortKey key, int a, int b) {
+    switch (key) {
+        case SORT_BY_PRICE:
+            if (columns.price[a] != columns.price[b]) return columns.price[a] < columns.price[b];
+            break;
+        case SORT_BY_RATING:
+            if (columns.rating[a] != columns.rating[b]) return columns.rating[a] < columns.rating[b];
+            break;
+        case SORT_BY_NAME: {
+            int cmp = compareSlotNames(a, b);
+            if (cmp != 0) return cmp < 0;
+            break;
+        }
+        default:
+            break;
+    }
+    return columns.id[a] < columns.id[b];
+}
+
+// Same sign as string::compare on the two names (unsigned bytes, then length)
+int compareSlotNames(int a, int b) {
+    if (columns.name[a].prefix != columns.name[b].prefix) {
+        return columns.name[a].prefix < columns.name[b].prefix ? -1 : 1;
+    }
+    size_t lengthA = columns.name[a].length;
+    size_t lengthB = columns.name[b].length;
+    size_t shared = min(lengthA, lengthB);
+    int cmp = shared == 0 ? 0 : memcmp(columnName(a), columnName(b), shared);
+    if (cmp != 0) return cmp;
+    return lengthA < lengthB ? -1 : (lengthA > lengthB ? 1 : 0);
+}
+
+void insertIntoView(SortKey key, int slot) {
+    vector<int>& view = sortedViews[key];
+    auto pos = upper_bound(view.begin(), view.end(), slot,
+        [key](int a, int b) { return slotLess(key, a, b); });
+    view.insert(pos, slot);
+}
+
+// Must run while the slot's columns still hold the values it was inserted with
+void eraseFromView(SortKey key, int slot) {
+    vector<int>& view = sortedViews[key];
+    auto pos = lower_bound(view.begin(), view.end(), slot,
+        [key](int a, int b) { return slotLess(key, a, b); });
+    view.erase(pos);
+}
+
+// Re-sorts every view from the store in O(n log n); used after bulk loads,
+// where inserting into the middle of the views one product at a time would
+// shift O(n) slots per product.
+void rebuildSortedViews() {
+    int size = columns.id.size();
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        vector<int>& view = sortedViews[key];
+        view.clear();
+        view.reserve(size - freeSlots.size());
+        for (int slot = 0; slot < size; ++slot) {
+            if (columns.id[slot] != 0) view.push_back(slot);
+        }
+        SortKey k = static_cast<SortKey>(key);
+        auto less = [k](int a, int b) { return slotLess(k, a, b); };
+        // After a bulk load the store is in ID order, so the ID view needs no sort
+        if (!is_sorted(view.begin(), view.end(), less)) {
+            selectTopSlots(view, k, true, view.size());
+        }
+    }
+}
+
+// Top-K read of a view: positions [offset, offset + limit) in ascending
+// order, or counted from the end when descending. The views are already
+// sorted, so a page costs O(limit) whatever the catalog size.
+vector<int> sortedPage(SortKey key, bool ascending, size_t offset, size_t limit) {
+    const vector<int>& view = sortedViews[key];
+    vector<int> page;
+    for (size_t i = offset; i < view.size() && i < offset + limit; ++i) {
+        page.push_back(ascending ? view[i] : view[view.size() - 1 - i]);
+    }
+    return page;
+}
+
+size_t cartBucket(int productID, size_t buckets) {
+    uint32_t hash = static_cast<uint32_t>(productID) * 2654435761u;
+    return (hash ^ (hash >> 16)) & (buckets - 1);
+}
+
+// Position of the product's line in in.lines, or -1
+int findCartLine(const Cart& in, int productID) {
+    if (in.index.empty()) return -1;
+    size_t mask = in.index.size() - 1;
+    for (size_t bucket = cartBucket(productID, in.index.size());; bucket = (bucket + 1) & mask) {
+        int entry = in.index[bucket];
+        if (entry == 0) return -1;
+        if (in.lines[entry - 1].productID == productID) return entry - 1;
+    }
+}
+
+void placeCartLine(Cart& in, size_t line) {
+    size_t mask = in.index.size() - 1;
+    size_t bucket = cartBucket(in.lines[line].productID, in.index.size());
+    while (in.index[bucket] != 0) bucket = (bucket + 1) & mask;
+    in.index[bucket] = static_cast<int>(line) + 1;
+}
+
+void rebuildCartIndex(Cart& in, size_t buckets) {
+    in.index.assign(buckets, 0);
+    for (size_t line = 0; line < in.lines.size(); ++line) {
+        placeCartLine(in, line);
+    }
+}
+
+// Adds quantity units at this unit price, merging them into the product's
+// line when it already has one. O(1) expected. The other cart functions,
+// console and session alike, are built on these.
+bool addCartLine(Cart& into, int productID, int slot, float price, int quantity) {
+    if (quantity <= 0 || quantity > MAX_CART_QUANTITY) return false;
+
+    int line = findCartLine(into, productID);
+    if (line == -1) {
+        if ((into.lines.size() + 1) * 2 > into.index.size()) {
+            rebuildCartIndex(into, max<size_t>(16, into.index.size() * 2));
+        }
+        line = into.lines.size();
+        into.lines.push_back(CartLine{productID, slot, 0, price});
+        placeCartLine(into, line);
+    } else if (quantity > MAX_CART_QUANTITY - into.lines[line].quantity) {
+        return false;
+    }
+
+    into.lines[line].quantity += quantity;
+    into.itemCount += quantity;
+    into.total += static_cast<double>(into.lines[line].price) * quantity;
+    return true;
+}
+
+// A quantity of 0 removes the line
+bool setCartLineQuantity(Cart& into, int productID, int quantity) {
+    int found = findCartLine(into, productID);
+    if (found == -1 || quantity < 0 || quantity > MAX_CART_QUANTITY) return false;
+
+    CartLine& line = into.lines[found];
+    int change = quantity - line.quantity;
+    into.itemCount += change;
+    into.total += static_cast<double>(line.price) * change;
+    if (quantity == 0) {
+        eraseCartLine(into, found);
+    } else {
+        line.quantity = quantity;
+    }
+    return true;
+}
+
+// Moves the last line into the gap so removal stays O(1). The index entry is
+// removed by shifting later entries of the same probe run back, so lookups
+// never need tombstones. Totals are the caller's job.
+void eraseCartLine(Cart& from, size_t line) {
+    size_t mask = from.index.size() - 1;
+    size_t hole = cartBucket(from.lines[line].productID, from.index.size());
+    while (from.index[hole] != static_cast<int>(line) + 1) hole = (hole + 1) & mask;
+    for (size_t next = (hole + 1) & mask; from.index[next] != 0; next = (next + 1) & mask) {
+        size_t home = cartBucket(from.lines[from.index[next] - 1].productID, from.index.size());
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            from.index[hole] = from.index[next];
+            hole = next;
+        }
+    }
+    from.index[hole] = 0;
+
+    size_t last = from.lines.size() - 1;
+    if (line != last) {
+        size_t bucket = cartBucket(from.lines[last].productID, from.index.size());
+        while (from.index[bucket] != static_cast<int>(last) + 1) bucket = (bucket + 1) & mask;
+        from.index[bucket] = static_cast<int>(line) + 1;
+        from.lines[line] = from.lines[last];
+    }
+    from.lines.pop_back();
+    // Don't let rounding from many small updates outlive the last line
+    if (from.lines.empty()) from.total = 0.0;
+}
+
+// Keeps the line and bucket capacity, so a recycled cart fills without allocating
+void resetCart(Cart& target) {
+    target.lines.clear();
+    fill(target.index.begin(), target.index.end(), 0);
+    target.total = 0.0;
+    target.itemCount = 0;
+}
+
+// The console cart
+bool addToCart(int slot, int quantity) {
+    return addCartLine(cart, columns.id[slot], slot, columns.price[slot], quantity);
+}
+
+bool setCartQuantity(int productID, int quantity) {
+    return setCartLineQuantity(cart, productID, quantity);
+}
+
+bool isInCart(int productID) {
+    return findCartLine(cart, productID) != -1;
+}
+
+void clearCart() {
+    resetCart(cart);
+}
+
+// Re-resolves every line after a load has renumbered the slots, drops the
+// products that no longer exist and recomputes the totals from scratch
+void relinkCart() {
+    if (cart.lines.empty()) return;
+
+    size_t kept = 0;
+    cart.total = 0.0;
+    cart.itemCount = 0;
+    for (size_t i = 0; i < cart.lines.size(); ++i) {
+        CartLine line = cart.lines[i];
+        Node* node = searchNode(root, line.productID);
+        if (node == nullptr) continue;
+        line.slot = node->slot;
+        line.price = columns.price[line.slot];
+        cart.lines[kept++] = line;
+        cart.itemCount += line.quantity;
+        cart.total += static_cast<double>(line.price) * line.quantity;
+    }
+    cart.lines.resize(kept);
+    rebuildCartIndex(cart, cart.index.size());
+}
+
+// Hooks for the mutation API. Both go by ID only, since they also run while
+// a load is replaying the log and cart slots are not yet relinked.
+void cartPriceChanged(int productID, float newPrice) {
+    int found = findCartLine(cart, productID);
+    if (found == -1) return;
+    CartLine& line = cart.lines[found];
+    cart.total += (static_cast<double>(newPrice) - line.price) * line.quantity;
+    line.price = newPrice;
+}
+
+void cartProductRemoved(int productID) {
+    if (isInCart(productID)) setCartQuantity(productID, 0);
+}
+
+// Starts a session with an empty cart and returns its key. Keys are the
+// session counter run through a 64-bit mixer, so they are spread evenly over
+// the shards and are not simply consecutive.
+uint64_t openCartSession() {
+    uint64_t key = cartSessionCounter.fetch_add(1) + 1;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+
+    CartShard& shard = cartShardOf(key);
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> hold(shard.lock);
+    if (now - shard.lastSweep > CART_SWEEP_INTERVAL) {
+        sweepCartShard(shard, now - cartIdleTimeout);
+    }
+    Cart* fresh;
+    if (!shard.spareCarts.empty()) {
+        fresh = shard.spareCarts.back();
+        shard.spareCarts.pop_back();
+    } else {
+        fresh = new Cart{{}, {}, 0.0, 0};
+    }
+    shard.sessions[key] = CartSession{fresh, now};
+    return key;
+}
+
+bool closeCartSession(uint64_t session) {
+    CartShard& shard = cartShardOf(session);
+    lock_guard<mutex> hold(shard.lock);
+    auto found = shard.sessions.find(session);
+    if (found == shard.sessions.end()) return false;
+    recycleCart(shard, found->second.cart);
+    shard.sessions.erase(found);
+    return true;
+}
+
+// Prices the product from the caller's snapshot, outside the shard lock.
+// False for an unknown or expired session, an unknown product or a bad
+// quantity.
+bool sessionAddToCart(const CatalogSnapshot& snapshot, uint64_t session, int productID, int quantity) {
+    int slot = snapshotFind(snapshot, productID);
+    if (slot == -1) return false;
+    float price = (*snapshot.price)[slot];
+
+    CartShard& shard = cartShardOf(session);
+    lock_guard<mutex> hold(shard.lock);
+    CartSession* entry = touchCartSession(shard, session);
+    return entry != nullptr && addCartLine(*entry->cart, productID, slot, price, quantity);
+}
+
+bool sessionSetQuantity(uint64_t session, int productID, int quantity) {
+    CartShard& shard = cartShardOf(session);
+    lock_guard<mutex> hold(shard.lock);
+    CartSession* entry = touchCartSession(shard, session);
+    return entry != nullptr && setCartLineQuantity(*entry->cart, productID, quantity);
+}
+
+// Running totals at the prices the lines were added at
+bool sessionCartSummary(uint64_t session, CartReceipt& summary) {
+    CartShard& shard = cartShardOf(session);
+    lock_guard<mutex> hold(shard.lock);
+    CartSession* entry = touchCartSession(shard, session);
+    if (entry == nullptr) return false;
+    summary = CartReceipt{entry->cart->lines.size(), entry->cart->itemCount, entry->cart->total, 0};
+    return true;
+}
+
+// Copies the lines out, so they can be listed without holding the shard lock
+bool sessionCartLines(uint64_t session, vector<CartLine>& lines, CartReceipt& summary) {
+    CartShard& shard = cartShardOf(session);
+    lock_guard<mutex> hold(shard.lock);
+    CartSession* entry = touchCartSession(shard, session);
+    if (entry == nullptr) return false;
+    lines = entry->cart->lines;
+    summary = CartReceipt{entry->cart->lines.size(), entry->cart->itemCount, entry->cart->total, 0};
+    return true;
+}
+
+// Quantity of the product in the cart, 0 if it has none, -1 for an unknown
+// or expired session
+int sessionLineQuantity(uint64_t session, int productID) {
+    CartShard& shard = cartShardOf(session);
+    lock_guard<mutex> hold(shard.lock);
+    CartSession* entry = touchCartSession(shard, session);
+    if (entry == nullptr) return -1;
+    int line = findCartLine(*entry->cart, productID);
+    return line == -1 ? 0 : entry->cart->lines[line].quantity;
+}
+
+// Reprices every line against the snapshot, skipping products that have
+// since been removed, and empties the cart. The session stays open.
+bool sessionCheckout(const CatalogSnapshot& snapshot, uint64_t session, CartReceipt& receipt) {
+    CartShard& shard = cartShardOf(session);
+    lock_guard<mutex> hold(shard.lock);
+    CartSession* entry = touchCartSession(shard, session);
+    if (entry == nullptr) return false;
+
+    receipt = CartReceipt{0, 0, 0.0, 0};
+    for (const CartLine& line : entry->cart->lines) {
+        int slot = snapshotFind(snapshot, line.productID);
+        if (slot == -1) {
+            receipt.dropped++;
+            continue;
+        }
+        receipt.lines++;
+        receipt.items += line.quantity;
+        receipt.total += static_cast<double>((*snapshot.price)[slot]) * line.quantity;
+    }
+    resetCart(*entry->cart);
+    return true;
+}
+
+// Drops every session last used before the cutoff; returns how many
+size_t expireIdleCarts(chrono::steady_clock::time_point cutoff) {
+    size_t expired = 0;
+    for (CartShard& shard : cartShards) {
+        lock_guard<mutex> hold(shard.lock);
+        expired += sweepCartShard(shard, cutoff);
+    }
+    return expired;
+}
+
+CartShard& cartShardOf(uint64_t session) {
+    return cartShards[session % CART_SHARD_COUNT];
+}
+
+// Caller holds the shard lock
+void recycleCart(CartShard& shard, Cart* spent) {
+    if (shard.spareCarts.size() < SPARE_CARTS_PER_SHARD && spent->lines.capacity() <= SPARE_CART_MAX_LINES) {
+        resetCart(*spent);
+        shard.spareCarts.push_back(spent);
+    } else {
+        delete spent;
+    }
+}
+
+// Caller holds the shard lock
+size_t sweepCartShard(CartShard& shard, chrono::steady_clock::time_point cutoff) {
+    size_t expired = 0;
+    for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+        if (it->second.lastUsed < cutoff) {
+            recycleCart(shard, it->second.cart);
+            it = shard.sessions.erase(it);
+            expired++;
+        } else {
+            ++it;
+        }
+    }
+    shard.lastSweep = chrono::steady_clock::now();
+    return expired;
+}
+
+// Caller holds the shard lock. Marks the session used now; nullptr when it
+// does not exist or has been idle past the timeout (it is then dropped).
+CartSession* touchCartSession(CartShard& shard, uint64_t session) {
+    auto found = shard.sessions.find(session);
+    if (found == shard.sessions.end()) return nullptr;
+    auto now = chrono::steady_clock::now();
+    if (now - found->second.lastUsed > cartIdleTimeout) {
+        recycleCart(shard, found->second.cart);
+        shard.sessions.erase(found);
+        return nullptr;
+    }
+    found->second.lastUsed = now;
+    return &found->second;
+}
+
+// Function definitions
+int generateProductNumber() {
+    return idAllocator.nextID++;
+}
+
+// Reserves a contiguous block of product numbers for a batch import and
+// returns the first one; the caller owns [first, first + count).
+int reserveProductIDs(int count) {
+    int first = idAllocator.nextID;
+    idAllocator.nextID += count;
+    return first;
+}
+
+int peekNextProductNumber() {
+    return idAllocator.nextID;
+}
+
+// The largest ID in a BST is its rightmost node
+int findMaxID(Node* root) {
+    if (root == nullptr) return 0;
+    
+    while (root->right != nullptr) {
+        root = root->right;
+    }
+    return root->id;
+}
+
+string formatProductID(int number) {
+    return "PID" + (number < 10 ? "0" + to_string(number) : to_string(number));
+}
+
+Node* createNode(int id, int slot) {
+    Node* newNode = nodePool.freeList;
+    if (newNode != nullptr) {
+        nodePool.freeList = newNode->left;
+    } else {
+        if (nodePool.used == NODE_BLOCK_SIZE) {
+            nodePool.blocks.push_back(new Node[NODE_BLOCK_SIZE]);
+            nodePool.used = 0;
+        }
+        newNode = &nodePool.blocks.back()[nodePool.used++];
+    }
+    nodePool.live++;
+    newNode->id = id;
+    newNode->slot = slot;
+    newNode->left = nullptr;
+    newNode->right = nullptr;
+    newNode->height = 1;
+    return newNode;
+}
+
+void freeNode(Node* node) {
+    node->left = nodePool.freeList;
+    nodePool.freeList = node;
+    nodePool.live--;
+}
+
+// Drops every node at once. Only valid when no tree built from the pool is
+// still in use; clearCatalog checks that the catalog tree is the only one.
+void releaseNodePool() {
+    for (Node* block : nodePool.blocks) {
+        delete[] block;
+    }
+    nodePool.blocks.clear();
+    nodePool.used = NODE_BLOCK_SIZE;
+    nodePool.freeList = nullptr;
+    nodePool.live = 0;
+}
+
+int nodeHeight(Node* node) {
+    return node == nullptr ? 0 : node->height;
+}
+
+void updateHeight(Node* node) {
+    node->height = 1 + max(nodeHeight(node->left), nodeHeight(node->right));
+}
+
+Node* rotateLeft(Node* node) {
+    Node* pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+Node* rotateRight(Node* node) {
+    Node* pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+// Restores the AVL invariant at a single node and returns the new subtree root
+Node* rebalance(Node* node) {
+    updateHeight(node);
+    int balance = nodeHeight(node->left) - nodeHeight(node->right);
+
+    if (balance > 1) {
+        if (nodeHeight(node->left->left) < nodeHeight(node->left->right)) {
+            node->left = rotateLeft(node->left);
+        }
+        return rotateRight(node);
+    }
+    if (balance < -1) {
+        if (nodeHeight(node->right->right) < nodeHeight(node->right->left)) {
+            node->right = rotateRight(node->right);
+        }
+        return rotateLeft(node);
+    }
+    return node;
+}
+
+Node* insertNode(Node* root, int id, int slot) {
+    // Walk down iteratively, remembering the path for the rebalancing pass
+    Node* path[MAX_TREE_HEIGHT];
+    int depth = 0;
+
+    Node* current = root;
+    while (current != nullptr) {
+        if (id == current->id) {
+            cout << "Product with ID " << formatProductID(id) << " already exists.\n";
+            return root;
+        }
+        path[depth++] = current;
+        current = (id < current->id) ? current->left : current->right;
+    }
+
+    Node* child = createNode(id, slot);
+
+    // Re-attach and rebalance bottom-up; rotations may replace each subtree root
+    for (int i = depth - 1; i >= 0; --i) {
+        Node* parent = path[i];
+        if (id < parent->id) {
+            parent->left = child;
+        } else {
+            parent->right = child;
+        }
+        child = rebalance(parent);
+    }
+    return child;
+}
+
+Node* searchNode(Node* root, int targetID) {
+    Node* current = root;
+
+    while (current != nullptr && current->id != targetID) {
+        if (targetID < current->id) {
+            current = current->left;
+        } else {
+            current = current->right;
+        }
+    }
+    return current;
+}
+
+Node* deleteNode(Node* root, int targetID) {
+    Node* path[MAX_TREE_HEIGHT];
+    int depth = 0;
+
+    Node* current = root;
+    while (current != nullptr && current->id != targetID) {
+        path[depth++] = current;
+        current = (targetID < current->id) ? current->left : current->right;
+    }
+    if (current == nullptr) return root;
+
+    // A node with two children takes over its in-order successor's entry,
+    // and the successor (which has no left child) is unlinked instead
+    if (current->left != nullptr && current->right != nullptr) {
+        path[depth++] = current;
+        Node* successor = current->right;
+        while (successor->left != nullptr) {
+            path[depth++] = successor;
+            successor = successor->left;
+        }
+        current->id = successor->id;
+        current->slot = successor->slot;
+        current = successor;
+    }
+
+    Node* removed = current;
+    Node* child = (removed->left != nullptr) ? removed->left : removed->right;
+
+    // Re-link by pointer identity (keys on the path may have been overwritten)
+    Node* oldChild = removed;
+    for (int i = depth - 1; i >= 0; --i) {
+        Node* parent = path[i];
+        if (parent->left == oldChild) {
+            parent->left = child;
+        } else {
+            parent->right = child;
+        }
+        oldChild = parent;
+        child = rebalance(parent);
+    }
+    freeNode(removed);
+    return child;
+}
+
+// Builds a balanced tree over slots already in ascending ID order in O(n):
+// the middle slot of each range becomes that subtree's root, so sibling
+// subtrees differ in size by at most one and the AVL invariant holds without
+// any rotations. Recursion depth is O(log n).
+Node* buildTreeFromSorted(const vector<int>& slots, int first, int last) {
+    if (first >= last) return nullptr;
+    int mid = first + (last - first) / 2;
+    Node* node = createNode(columns.id[slots[mid]], slots[mid]);
+    node->left = buildTreeFromSorted(slots, first, mid);
+    node->right = buildTreeFromSorted(slots, mid + 1, last);
+    updateHeight(node);
+    return node;
+}
+
+void destroyTree(Node* root) {
+    Node* stack[MAX_TREE_HEIGHT];
+    int top = 0;
+    if (root != nullptr) stack[top++] = root;
+
+    while (top > 0) {
+        Node* node = stack[--top];
+        if (node->left != nullptr) stack[top++] = node->left;
+        if (node->right != nullptr) stack[top++] = node->right;
+        freeNode(node);
+    }
+}
+
+bool isValidNameOrCategory(const string& str) {
+    if (str.empty()) return false;
+    bool hasAlpha = false;
+    for (char c : str) {
+        if (isalpha(c)) hasAlpha = true;
+        else if (!isspace(c)) return false;
+    }
+    return hasAlpha;
+}
+
+// Writes product into slot, growing the columns for a new slot. The name is
+// only appended to the arena when it changed.
+void storeColumns(int slot, const Product& product) {
+    if (static_cast<size_t>(slot) >= columns.id.size()) {
+        resizeColumns(slot + 1);
+    }
+    columns.id[slot] = product.id;
+    columns.categoryCode[slot] = product.categoryCode;
+    columns.price[slot] = product.price;
+    columns.rating[slot] = product.rating;
+
+    size_t length = columns.name[slot].length;
+    if (length == product.name.size() && (length == 0 || memcmp(columnName(slot), product.name.data(), length) == 0)) return;
+    columns.deadNameBytes += length;
+    columns.name[slot] = NameSpan{namePrefix(product.name.data(), product.name.size()),
+                                  columns.nameArena.size(), product.name.size()};
+    columns.nameArena.insert(columns.nameArena.end(), product.name.begin(), product.name.end());
+    if (columns.deadNameBytes > columns.nameArena.size() / 2) packNameArena();
+}
+
+// NaN fails every comparison and -1 is no category, so the filter kernels
+// skip free slots without a separate liveness mask
+void clearColumns(int slot) {
+    columns.id[slot] = 0;
+    columns.categoryCode[slot] = -1;
+    columns.price[slot] = numeric_limits<float>::quiet_NaN();
+    columns.rating[slot] = numeric_limits<float>::quiet_NaN();
+    columns.deadNameBytes += columns.name[slot].length;
+    columns.name[slot].length = 0;
+}
+
+void resizeColumns(size_t size) {
+    columns.id.resize(size, 0);
+    columns.categoryCode.resize(size, 0);
+    columns.price.resize(size, 0.0f);
+    columns.rating.resize(size, 0.0f);
+    columns.name.resize(size, NameSpan{0, 0, 0});
+}
+
+Product productAt(int slot) {
+    Product product;
+    product.id = columns.id[slot];
+    product.name.assign(columnName(slot), columns.name[slot].length);
+    product.categoryCode = columns.categoryCode[slot];
+    product.price = columns.price[slot];
+    product.rating = columns.rating[slot];
+    return product;
+}
+
+// Every product as a row, in ID order. Only the benchmarks use it, as the
+// array-of-structs baseline the column scans are measured against.
+vector<Product> copyProducts() {
+    vector<Product> products;
+    products.reserve(idView.size());
+    for (int slot : idView) {
+        products.push_back(productAt(slot));
+    }
+    return products;
+}
+
+// Drops the dead bytes by copying every live name into a fresh arena
+void packNameArena() {
+    vector<char> packed;
+    packed.reserve(columns.nameArena.size() - columns.deadNameBytes);
+    for (size_t slot = 0; slot < columns.id.size(); ++slot) {
+        const char* name = columnName(slot);
+        columns.name[slot].offset = packed.size();
+        packed.insert(packed.end(), name, name + columns.name[slot].length);
+    }
+    columns.nameArena.swap(packed);
+    columns.deadNameBytes = 0;
+}
+
+// Not NUL-terminated; the length is columns.name[slot].length. Only valid until
+// the next change to the columns, which may move the arena.
+const char* columnName(int slot) {
+    return columns.nameArena.data() + columns.name[slot].offset;
+}
+
+uint64_t namePrefix(const char* name, size_t length) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        unsigned char c = i < length ? static_cast<unsigned char>(name[i]) : 0;
+        prefix = (prefix << 8) | c;
+    }
+    return prefix;
+}
+
+// Mutation API: every change goes through these so the BST, the columns and
+// all sorted views stay in step. Each view is updated by binary search; an
+// update only touches the views whose key actually changed. Each change is
+// also queued for the mutation log; callers end a batch with syncMutationLog.
+bool addProduct(const Product& p) {
+    if (searchNode(root, p.id) != nullptr) {
+        cout << "Product with ID " << formatProductID(p.id) << " already exists.\n";
+        return false;
+    }
+
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = columns.id.size();
+    }
+    storeColumns(slot, p);
+
+    root = insertNode(root, p.id, slot);
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        insertIntoView(static_cast<SortKey>(key), slot);
+    }
+    snapshotStale |= SNAPSHOT_ALL & ~SNAPSHOT_CATEGORIES;
+    indexProductName(p.id, slot, p.name);
+    indexProductCategory(slot);
+    logMutation(LOG_ADD, p);
+
+    // Keep the allocator ahead of products added with an explicit ID
+    if (p.id >= idAllocator.nextID) {
+        idAllocator.nextID = p.id + 1;
+    }
+    return true;
+}
+
+bool updateProduct(const Product& p) {
+    Node* node = searchNode(root, p.id);
+    if (node == nullptr) return false;
+
+    Product stored = productAt(node->slot);
+    bool moved[SORT_KEY_COUNT];
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        SortKey k = static_cast<SortKey>(key);
+        moved[key] = keyLess(k, stored, p) || keyLess(k, p, stored);
+        if (moved[key]) eraseFromView(k, node->slot);
+    }
+    // Views tie on ID, so a view moves exactly when its key changed
+    const unsigned changedColumn[SORT_KEY_COUNT] = {0, SNAPSHOT_PRICES, SNAPSHOT_RATINGS, SNAPSHOT_NAMES};
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        if (moved[key]) snapshotStale |= (1u << key) | changedColumn[key];
+    }
+
+    if (stored.name != p.name) {
+        unindexProductName(p.id, node->slot, stored.name);
+        indexProductName(p.id, node->slot, p.name);
+    }
+
+    if (stored.price != p.price) cartPriceChanged(p.id, p.price);
+
+    bool recategorized = stored.categoryCode != p.categoryCode;
+    if (recategorized) {
+        unindexProductCategory(node->slot);
+        snapshotStale |= SNAPSHOT_CATEGORY_CODES;
+    }
+    storeColumns(node->slot, p);
+    if (recategorized) indexProductCategory(node->slot);
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        if (moved[key]) insertIntoView(static_cast<SortKey>(key), node->slot);
+    }
+    logMutation(LOG_UPDATE, p);
+    return true;
+}
+
+bool removeProduct(int id) {
+    Node* node = searchNode(root, id);
+    if (node == nullptr) return false;
+
+    int slot = node->slot;
+    Product removed = productAt(slot);
+    logMutation(LOG_REMOVE, removed);
+    cartProductRemoved(id);
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        eraseFromView(static_cast<SortKey>(key), slot);
+    }
+    snapshotStale |= SNAPSHOT_ALL & ~SNAPSHOT_CATEGORIES;
+    unindexProductName(id, slot, removed.name);
+    unindexProductCategory(slot);
+    root = deleteNode(root, id);
+
+    clearColumns(slot);
+    freeSlots.push_back(slot);
+    return true;
+}
+
+// Makes the current catalog visible to snapshot readers. Only the writer
+// calls this, after a batch of mutations; unchanged parts are shared with the
+// previous snapshot, and a publish with nothing changed is free.
+void publishSnapshot() {
+    const CatalogSnapshot* previous = publishedSnapshot.load();
+    if (previous != nullptr && snapshotStale == 0) return;
+
+    CatalogSnapshot* next = new CatalogSnapshot();
+    next->version = previous == nullptr ? 1 : previous->version + 1;
+    auto reuse = [previous](unsigned part) { return previous != nullptr && (snapshotStale & part) == 0; };
+    next->id = reuse(SNAPSHOT_IDS) ? previous->id : make_shared<const vector<int>>(columns.id);
+    next->categoryCode = reuse(SNAPSHOT_CATEGORY_CODES) ? previous->categoryCode
+                                                        : make_shared<const vector<int>>(columns.categoryCode);
+    next->price = reuse(SNAPSHOT_PRICES) ? previous->price : make_shared<const vector<float>>(columns.price);
+    next->rating = reuse(SNAPSHOT_RATINGS) ? previous->rating : make_shared<const vector<float>>(columns.rating);
+    if (reuse(SNAPSHOT_NAMES)) {
+        next->name = previous->name;
+        next->nameArena = previous->nameArena;
+    } else {
+        next->name = make_shared<const vector<NameSpan>>(columns.name);
+        next->nameArena = make_shared<const vector<char>>(columns.nameArena);
+    }
+    for (int key = 0; key < SORT_KEY_COUNT; ++key) {
+        next->views[key] = reuse(1u << key) ? previous->views[key] : make_shared<const vector<int>>(sortedViews[key]);
+    }
+    next->categoryNames = reuse(SNAPSHOT_CATEGORIES) ? previous->categoryNames
+                                                     : make_shared<const vector<string>>(categoryNames);
+    // Never copied here; a name change after this publish copies the live ones
+    next->nameIndex = nameIndex;
+    next->trigramIndex = trigramIndex;
+    snapshotStale = 0;
+
+    publishedSnapshot.store(next);
+    if (previous != nullptr) {
+        retiredSnapshots.push_back(RetiredSnapshot{previous, snapshotEpoch.fetch_add(1) + 1});
+    }
+    reclaimSnapshots();
+}
+
+// Keeps the snapshot current once readers have asked for one; a catalog that
+// never had readers pays nothing
+void refreshSnapshot() {
+    if (publishedSnapshot.load() != nullptr) publishSnapshot();
+}
+
+// Deletes the retired snapshots no reader can still be using
+void reclaimSnapshots() {
+    uint64_t oldest = numeric_limits<uint64_t>::max();
+    for (const SnapshotReader& reader : snapshotReaders) {
+        uint64_t epoch = reader.epoch.load();
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    size_t kept = 0;
+    for (const RetiredSnapshot& retired : retiredSnapshots) {
+        if (retired.epoch <= oldest) {
+            delete retired.snapshot;
+        } else {
+            retiredSnapshots[kept++] = retired;
+        }
+    }
+    retiredSnapshots.resize(kept);
+}
+
+// Reader threads claim a slot once and pass it to every enterSnapshot call.
+// Returns -1 when all MAX_SNAPSHOT_READERS slots are taken.
+int claimSnapshotReader() {
+    for (int reader = 0; reader < MAX_SNAPSHOT_READERS; ++reader) {
+        bool expected = false;
+        if (snapshotReaders[reader].claimed.compare_exchange_strong(expected, true)) return reader;
+    }
+    return -1;
+}
+
+void releaseSnapshotReader(int reader) {
+    snapshotReaders[reader].epoch.store(0);
+    snapshotReaders[reader].claimed.store(false);
+}
+
+// The returned snapshot stays valid until the same reader calls leaveSnapshot.
+// Both are a handful of atomic loads and stores on the reader's own slot.
+const CatalogSnapshot* enterSnapshot(int reader) {
+    snapshotReaders[reader].epoch.store(snapshotEpoch.load());
+    return publishedSnapshot.load();
+}
+
+void leaveSnapshot(int reader) {
+    snapshotReaders[reader].epoch.store(0, memory_order_release);
+}
+
+// Slot of the product with this ID in the snapshot, or -1; a binary search of
+// the snapshot's ID view
+int snapshotFind(const CatalogSnapshot& snapshot, int id) {
+    const vector<int>& view = *snapshot.views[SORT_BY_ID];
+    const vector<int>& ids = *snapshot.id;
+    auto pos = lower_bound(view.begin(), view.end(), id, [&ids](int slot, int target) { return ids[slot] < target; });
+    return (pos != view.end() && ids[*pos] == id) ? *pos : -1;
+}
+
+Product snapshotProduct(const CatalogSnapshot& snapshot, int slot) {
+    const NameSpan& name = (*snapshot.name)[slot];
+    Product product;
+    product.id = (*snapshot.id)[slot];
+    product.name.assign(snapshot.nameArena->data() + name.offset, name.length);
+    product.categoryCode = (*snapshot.categoryCode)[slot];
+    product.price = (*snapshot.price)[slot];
+    product.rating = (*snapshot.rating)[slot];
+    return product;
+}
+
+// runQuery against a snapshot. The view for the sort key is walked in order
+// (only the matching range of it when the sort key is also a range
+// predicate) and each slot is checked until the page is full. A walk still
+// going after 1/ATTRIBUTE_SCAN_SHARE of the slots turns the attribute
+// predicates into one bitmap with the filter kernels, so each further step
+// is a bit test instead of three random column reads; a price range of
+// [-inf, inf] selects every live slot, since free slots hold NaN.
+vector<int> snapshotQuery(const CatalogSnapshot& snapshot, const ProductQuery& query) {
+    vector<int> result;
+    const vector<int>& categoryCodes = *snapshot.categoryCode;
+    const vector<float>& prices = *snapshot.price;
+    const vector<float>& ratings = *snapshot.rating;
+    const vector<NameSpan>& names = *snapshot.name;
+    int code = -1;
+    if (!query.category.empty()) {
+        const vector<string>& categories = *snapshot.categoryNames;
+        code = find(categories.begin(), categories.end(), query.category) - categories.begin();
+        if (code == static_cast<int>(categories.size())) return result;
+    }
+    string needle;
+    for (char c : query.nameContains) {
+        needle += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+
+    const vector<int>& view = *snapshot.views[query.sortKey];
+    size_t first = 0, last = view.size();
+    const vector<float>* values = nullptr;
+    float low = 0.0f, high = 0.0f;
+    if (query.sortKey == SORT_BY_PRICE && query.hasPriceRange) {
+        values = &prices;
+        low = query.minPrice;
+        high = query.maxPrice;
+    } else if (query.sortKey == SORT_BY_RATING && query.hasRatingRange) {
+        values = &ratings;
+        low = query.minRating;
+        high = query.maxRating;
+    }
+    if (values != nullptr) {
+        const vector<float>& v = *values;
+        first = lower_bound(view.begin(), view.end(), low, [&v](int slot, float x) { return v[slot] < x; }) - view.begin();
+        last = upper_bound(view.begin() + first, view.end(), high, [&v](float x, int slot) { return x < v[slot]; }) - view.begin();
+    }
+
+    const size_t count = prices.size();
+    vector<uint64_t> selected;
+    auto buildMask = [&]() {
+        const FilterKernels& kernels = activeFilterKernels();
+        const size_t words = (count + 63) / 64;
+        const float infinity = numeric_limits<float>::infinity();
+        vector<uint64_t> mask(words);
+        selected.resize(words);
+        kernels.rangeMask(prices.data(), count, query.hasPriceRange ? query.minPrice : -infinity,
+                          query.hasPriceRange ? query.maxPrice : infinity, selected.data());
+        if (code >= 0) {
+            kernels.equalMask(categoryCodes.data(), count, code, mask.data());
+            andMask(selected.data(), mask.data(), words);
+        }
+        if (query.hasRatingRange) {
+            kernels.rangeMask(ratings.data(), count, query.minRating, query.maxRating, mask.data());
+            andMask(selected.data(), mask.data(), words);
+        }
+    };
+
+    size_t skipped = 0;
+    size_t maskAfter = first + count / ATTRIBUTE_SCAN_SHARE;
+    for (size_t i = first; i < last; ++i) {
+        if (i == maskAfter) buildMask();
+        int slot = query.ascending ? view[i] : view[last - 1 - (i - first)];
+        if (!selected.empty()) {
+            if ((selected[slot / 64] >> (slot % 64) & 1) == 0) continue;
+        } else {
+            if (code >= 0 && categoryCodes[slot] != code) continue;
+            float price = prices[slot];
+            if (query.hasPriceRange && (price < query.minPrice || price > query.maxPrice)) continue;
+            float rating = ratings[slot];
+            if (query.hasRatingRange && (rating < query.minRating || rating > query.maxRating)) continue;
+        }
+        if (!needle.empty() && !containsIgnoreCase(snapshot.nameArena->data() + names[slot].offset,
+                                                   names[slot].length, needle)) continue;
+        if (skipped < query.offset) {
+            skipped++;
+            continue;
+        }
+        result.push_back(slot);
+        if (query.limit > 0 && result.size() == query.limit) break;
+    }
+    return result;
+}
+
+// Executes commands from in until it ends, writing the answers to output
+// through an export buffer so millions of short answers cost few writes.
+// False only if the output could not be written.
+bool runBatch(istream& in, FILE* output, BatchStats& stats) {
+    ExportWriter out = {output, vector<char>(EXPORT_BUFFER_SIZE), 0, 0, false};
+    stats = BatchStats{0, 0, 0.0};
+    CommandContext context = {nullptr, 0, PAGE_SIZE};
+    string line;
+    size_t lineNumber = 0;
+    auto start = chrono::steady_clock::now();
+    while (getline(in, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t first = line.find_first_not_of(" \t");
+        if (first == string::npos || line[first] == '#') continue;
+        stats.commands++;
+        if (!runCommand(context, line.substr(first), lineNumber, out)) stats.failed++;
+    }
+    flushExport(out);
+    stats.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return !out.failed && fflush(output) == 0;
+}
+
+// Writes {"line":N,"cmd":"verb","ok":...,...} for one command; returns ok.
+// Every command reads either the live catalog or context.snapshot, so the
+// same command runs in --batch and on a server connection.
+bool runCommand(CommandContext& context, const string& line, size_t lineNumber, ExportWriter& out) {
+    size_t verbEnd = line.find_first_of(" \t");
+    string verb = line.substr(0, verbEnd);
+    size_t argsStart = verbEnd == string::npos ? string::npos : line.find_first_not_of(" \t", verbEnd);
+    string args = argsStart == string::npos ? "" : line.substr(argsStart);
+    while (!args.empty() && (args.back() == ' ' || args.back() == '\t')) args.pop_back();
+    const CatalogSnapshot* snapshot = context.snapshot;
+
+    char text[96];
+    auto begin = [&](bool ok) {
+        writeExport(out, text, snprintf(text, sizeof(text), "{\"line\":%zu,\"cmd\":", lineNumber));
+        writeJSONString(out, verb.data(), verb.size());
+        writeExport(out, ok ? ",\"ok\":true" : ",\"ok\":false", ok ? 10 : 11);
+    };
+    auto fail = [&](const char* error) {
+        begin(false);
+        writeExport(out, ",\"error\":", 9);
+        writeJSONString(out, error, strlen(error));
+        writeExport(out, "}\n", 2);
+        return false;
+    };
+    auto finish = [&]() {
+        writeExport(out, "}\n", 2);
+        return true;
+    };
+    auto cartTotals = [&](long long lines, long long items, double total) {
+        writeExport(out, text, snprintf(text, sizeof(text), ",\"lines\":%lld,\"items\":%lld,\"total\":%.2f",
+                                        lines, items, total));
+    };
+    auto findSlot = [&](int id) {
+        if (snapshot != nullptr) return snapshotFind(*snapshot, id);
+        Node* node = searchNode(root, id);
+        return node == nullptr ? -1 : node->slot;
+    };
+    // A session idle past cartIdleTimeout has been dropped with its cart
+    auto cartExpired = [&]() {
+        context.session = openCartSession();
+        return fail("cart expired; a new one was started");
+    };
+
+    if (verb == "find") {
+        int id = parseProductID(args);
+        if (id < 0) return fail("expected a product ID");
+        int slot = findSlot(id);
+        begin(true);
+        writeBatchProducts(out, snapshot, slot == -1 ? vector<int>() : vector<int>(1, slot), context.limit);
+        return finish();
+    }
+
+    if (verb == "name") {
+        if (args.empty()) return fail("expected a name");
+        // The same cascade as searchByName, over the snapshot's own indexes
+        // on a server connection
+        const char* match;
+        vector<int> ids = cascadeNameSearch(snapshot != nullptr ? snapshotNameSource(*snapshot) : liveNameSource(),
+                                            args, match);
+        vector<int> slots;
+        for (size_t i = 0; i < ids.size() && (context.limit == 0 || i < context.limit); ++i) {
+            slots.push_back(findSlot(ids[i]));
+        }
+        begin(true);
+        writeExport(out, text, snprintf(text, sizeof(text), ",\"match\":\"%s\",\"matches\":%zu",
+                                         match, ids.size()));
+        writeBatchProducts(out, snapshot, slots, context.limit);
+        return finish();
+    }
+
+    if (verb == "category" || verb == "price" || verb == "rating") {
+        ProductQuery query;
+        query.limit = context.limit;
+        if (verb == "category") {
+            if (args.empty()) return fail("expected a category");
+            query.category = args;
+        } else {
+            float low, high;
+            char extra;
+            if (sscanf(args.c_str(), "%f %f %c", &low, &high, &extra) != 2) return fail("expected two numbers");
+            bool price = verb == "price";
+            (price ? query.hasPriceRange : query.hasRatingRange) = true;
+            (price ? query.minPrice : query.minRating) = low;
+            (price ? query.maxPrice : query.maxRating) = high;
+        }
+        begin(true);
+        writeBatchProducts(out, snapshot, snapshot != nullptr ? snapshotQuery(*snapshot, query) : runQuery(query), 0);
+        return finish();
+    }
+
+    if (verb == "sort") {
+        char key[16] = "", order[8] = "asc", extra;
+        long offset = 0;
+        int fields = sscanf(args.c_str(), "%15s %7s %ld %c", key, order, &offset, &extra);
+        static const char* keyNames[SORT_KEY_COUNT] = {"id", "price", "rating", "name"};
+        int sortKey = -1;
+        for (int k = 0; k < SORT_KEY_COUNT; ++k) {
+            if (strcmp(key, keyNames[k]) == 0) sortKey = k;
+        }
+        bool ascending = strcmp(order, "asc") == 0;
+        if (fields < 1 || fields > 3 || sortKey < 0 || (!ascending && strcmp(order, "desc") != 0) || offset < 0) {
+            return fail("expected sort <id|price|rating|name> [asc|desc] [offset]");
+        }
+        vector<int> page;
+        if (snapshot != nullptr) {
+            ProductQuery query;
+            query.sortKey = static_cast<SortKey>(sortKey);
+            query.ascending = ascending;
+            query.offset = offset;
+            query.limit = context.limit;
+            page = snapshotQuery(*snapshot, query);
+        } else {
+            page = sortedPage(static_cast<SortKey>(sortKey), ascending, offset,
+                              context.limit == 0 ? idView.size() : context.limit);
+        }
+        begin(true);
+        writeBatchProducts(out, snapshot, page, 0);
+        return finish();
+    }
+
+    if (verb == "add" || verb == "qty") {
+        size_t split = args.find(' ');
+        int id = parseProductID(args.substr(0, split));
+        int quantity = verb == "add" ? 1 : -1;
+        if (split != string::npos) {
+            char extra;
+            if (sscanf(args.c_str() + split, "%d %c", &quantity, &extra) != 1) return fail("expected a quantity");
+        }
+        if (id < 0) return fail("expected a product ID");
+        if (snapshot != nullptr) {
+            int held = sessionLineQuantity(context.session, id);
+            if (held < 0) return cartExpired();
+            if (verb == "add") {
+                if (snapshotFind(*snapshot, id) == -1) return fail("no such product");
+                if (!sessionAddToCart(*snapshot, context.session, id, quantity)) return fail("invalid quantity");
+            } else {
+                if (held == 0) return fail("not in the cart");
+                if (!sessionSetQuantity(context.session, id, quantity)) return fail("invalid quantity");
+            }
+            CartReceipt summary;
+            if (!sessionCartSummary(context.session, summary)) return cartExpired();
+            begin(true);
+            writeExport(out, text, snprintf(text, sizeof(text), ",\"quantity\":%d",
+                                             max(sessionLineQuantity(context.session, id), 0)));
+            cartTotals(summary.lines, summary.items, summary.total);
+            return finish();
+        }
+        if (verb == "add") {
+            int slot = findSlot(id);
+            if (slot == -1) return fail("no such product");
+            if (!addToCart(slot, quantity)) return fail("invalid quantity");
+        } else {
+            if (!isInCart(id)) return fail("not in the cart");
+            if (!setCartQuantity(id, quantity)) return fail("invalid quantity");
+        }
+        int line = findCartLine(cart, id);
+        begin(true);
+        writeExport(out, text, snprintf(text, sizeof(text), ",\"quantity\":%d",
+                                         line == -1 ? 0 : cart.lines[line].quantity));
+        cartTotals(cart.lines.size(), cart.itemCount, cart.total);
+        return finish();
+    }
+
+    if (verb == "cart" || verb == "checkout") {
+        vector<CartLine> sessionLines;
+        CartReceipt summary = CartReceipt{cart.lines.size(), cart.itemCount, cart.total, 0};
+        if (snapshot != nullptr) {
+            if (!sessionCartLines(context.session, sessionLines, summary)) return cartExpired();
+            // Checkout reprices against the snapshot and empties the cart
+            if (verb == "checkout" && !sessionCheckout(*snapshot, context.session, summary)) return cartExpired();
+        }
+        const vector<CartLine>& lines = snapshot != nullptr ? sessionLines : cart.lines;
+        begin(true);
+        cartTotals(summary.lines, summary.items, summary.total);
+        writeExport(out, ",\"cart\":[", 9);
+        for (size_t i = 0; i < lines.size(); ++i) {
+            const CartLine& line = lines[i];
+            writeExport(out, text, snprintf(text, sizeof(text), "%s{\"id\":\"%s\",\"quantity\":%d,\"price\":",
+                                             i == 0 ? "" : ",", formatProductID(line.productID).c_str(),
+                                             line.quantity));
+            writeExportNumber(out, line.price);
+            writeExport(out, "}", 1);
+        }
+        writeExport(out, "]", 1);
+        if (verb == "checkout" && snapshot == nullptr) clearCart();
+        return finish();
+    }
+
+    if (verb == "save") {
+        // Server connections only read; the catalog has a single writer
+        if (snapshot != nullptr) return fail("not available on a server connection");
+        if (!saveCatalog()) return fail(("could not save " + catalogFilePath()).c_str());
+        begin(true);
+        writeExport(out, text, snprintf(text, sizeof(text), ",\"products\":%zu", idView.size()));
+        return finish();
+    }
+
+    if (verb == "limit") {
+        char extra;
+        long value;
+        if (sscanf(args.c_str(), "%ld %c", &value, &extra) != 1 || value < 0) return fail("expected a count");
+        context.limit = value;
+        begin(true);
+        writeExport(out, text, snprintf(text, sizeof(text), ",\"limit\":%zu", context.limit));
+        return finish();
+    }
+
+    return fail("unknown command");
+}
+
+// ,"count":N,"products":[{"id":..,"name":..,"category":..,"price":..,"rating":..},...]
+// for the first limit slots (all when limit is 0), read from the snapshot or,
+// when it is nullptr, the live columns
+void writeBatchProducts(ExportWriter& out, const CatalogSnapshot* snapshot, const vector<int>& slots, size_t limit) {
+    const vector<int>& ids = snapshot != nullptr ? *snapshot->id : columns.id;
+    const vector<int>& categoryCodes = snapshot != nullptr ? *snapshot->categoryCode : columns.categoryCode;
+    const vector<float>& prices = snapshot != nullptr ? *snapshot->price : columns.price;
+    const vector<float>& ratings = snapshot != nullptr ? *snapshot->rating : columns.rating;
+    const vector<NameSpan>& names = snapshot != nullptr ? *snapshot->name : columns.name;
+    const char* arena = snapshot != nullptr ? snapshot->nameArena->data() : columns.nameArena.data();
+    const vector<string>& categories = snapshot != nullptr ? *snapshot->categoryNames : categoryNames;
+
+    size_t count = limit == 0 ? slots.size() : min(limit, slots.size());
+    char text[48];
+    writeExport(out, text, snprintf(text, sizeof(text), ",\"count\":%zu,\"products\":[", count));
+    for (size_t i = 0; i < count; ++i) {
+        int slot = slots[i];
+        const string& category = categories[categoryCodes[slot]];
+        writeExport(out, text, snprintf(text, sizeof(text), "%s{\"id\":\"%s\",\"name\":", i == 0 ? "" : ",",
+                                         formatProductID(ids[slot]).c_str()));
+        writeJSONString(out, arena + names[slot].offset, names[slot].length);
+        writeExport(out, ",\"category\":", 12);
+        writeJSONString(out, category.data(), category.size());
+        writeExport(out, ",\"price\":", 9);
+        writeExportNumber(out, prices[slot]);
+        writeExport(out, ",\"rating\":", 10);
+        writeExportNumber(out, ratings[slot]);
+        writeExport(out, "}", 1);
+    }
+    writeExport(out, "]", 1);
+}
+
+void writeJSONString(ExportWriter& out, const char* text, size_t length) {
+    writeExport(out, "\"", 1);
+    const char* end = text + length;
+    const char* run = text;
+    for (const char* c = text; c != end; ++c) {
+        unsigned char byte = static_cast<unsigned char>(*c);
+        if (byte >= 0x20 && byte != '"' && byte != '\\') continue;
+        writeExport(out, run, c - run);
+        char escaped[8];
+        writeExport(out, escaped, snprintf(escaped, sizeof(escaped), "\\u%04x", byte));
+        run = c + 1;
+    }
+    writeExport(out, run, end - run);
+    writeExport(out, "\"", 1);
+}
+
+#ifdef __linux__
+// A TCP port on 127.0.0.1, or a Unix socket path when the address contains
+// a '/'; false if it is neither
+bool serverAddress(const string& address, sockaddr_storage& storage, socklen_t& length) {
+    memset(&storage, 0, sizeof(storage));
+    if (address.find('/') != string::npos) {
+        sockaddr_un& local = reinterpret_cast<sockaddr_un&>(storage);
+        if (address.size() >= sizeof(local.sun_path)) return false;
+        local.sun_family = AF_UNIX;
+        memcpy(local.sun_path, address.c_str(), address.size() + 1);
+        length = sizeof(sockaddr_un);
+        return true;
+    }
+    char* end;
+    long port = strtol(address.c_str(), &end, 10);
+    if (address.empty() || *end != '\0' || port < 1 || port > 65535) return false;
+    sockaddr_in& local = reinterpret_cast<sockaddr_in&>(storage);
+    local.sin_family = AF_INET;
+    local.sin_port = htons(static_cast<uint16_t>(port));
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    length = sizeof(sockaddr_in);
+    return true;
+}
+
+// Listening, non-blocking socket for runServer, or -1 with the error printed.
+// A socket file left behind by an earlier server is replaced; any other file
+// at that path is not.
+int openServerSocket(const string& address) {
+    sockaddr_storage storage;
+    socklen_t length;
+    if (!serverAddress(address, storage, length)) {
+        cerr << "Error: " << address << " is neither a port nor a socket path" << endl;
+        return -1;
+    }
+    struct stat existing;
+    if (storage.ss_family == AF_UNIX && stat(address.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        unlink(address.c_str());
+    }
+    int listener = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    if (listener >= 0 && storage.ss_family == AF_INET) {
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&storage), length) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        cerr << "Error: Could not listen on " << address << ": " << strerror(errno) << endl;
+        if (listener >= 0) close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+// Blocking client socket connected to a server address, or -1
+int connectServer(const string& address) {
+    sockaddr_storage storage;
+    socklen_t length;
+    if (!serverAddress(address, storage, length)) return -1;
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&storage), length) != 0) {
+        close(fd);
+        return -1;
+    }
+    int noDelay = 1;
+    if (storage.ss_family == AF_INET) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+// Handles one event for a connection: reads what the client sent, answers
+// every complete line against one snapshot and sends as much as the socket
+// takes. False once the client has gone or sent an overlong line.
+bool serveConnection(ServerConnection& connection, int reader, BatchStats& stats) {
+    bool open = true;
+    if (connection.output.used - connection.sent < SERVER_OUTPUT_HIGH_WATER) {
+        size_t kept = connection.input.size();
+        connection.input.resize(kept + SERVER_READ_SIZE);
+        ssize_t got;
+        do {
+            got = recv(connection.fd, &connection.input[kept], SERVER_READ_SIZE, 0);
+        } while (got < 0 && errno == EINTR);
+        connection.input.resize(kept + max<ssize_t>(got, 0));
+        if (got == 0) open = false;    // answer what arrived, then close
+        if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+    }
+
+    const string& input = connection.input;
+    size_t start = 0;
+    for (size_t end; (end = input.find('\n', start)) != string::npos; start = end + 1) {
+        connection.lineNumber++;
+        size_t first = input.find_first_not_of(" \t", start);
+        if (first >= end || input[first] == '#' || input[first] == '\r') continue;
+        size_t last = end;
+        if (input[last - 1] == '\r') last--;
+        if (connection.context.snapshot == nullptr) connection.context.snapshot = enterSnapshot(reader);
+        stats.commands++;
+        if (!runCommand(connection.context, input.substr(first, last - first), connection.lineNumber,
+                        connection.output)) {
+            stats.failed++;
+        }
+    }
+    if (connection.context.snapshot != nullptr) {
+        leaveSnapshot(reader);
+        connection.context.snapshot = nullptr;
+    }
+    connection.input.erase(0, start);
+    if (connection.input.size() > SERVER_MAX_LINE) return false;
+
+    ExportWriter& output = connection.output;
+    while (connection.sent < output.used) {
+        ssize_t put = send(connection.fd, output.buffer.data() + connection.sent, output.used - connection.sent,
+                           MSG_NOSIGNAL);
+        if (put > 0) {
+            connection.sent += put;
+        } else if (put < 0 && errno == EINTR) {
+            continue;
+        } else if (put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+    if (connection.sent == output.used) {
+        output.used = 0;
+        connection.sent = 0;
+        // One huge answer (limit 0) should not pin its buffer for good
+        if (output.buffer.size() > EXPORT_BUFFER_SIZE) vector<char>(SERVER_OUTPUT_INITIAL).swap(output.buffer);
+    }
+    return open;
+}
+#endif
+
+// Serves the published snapshot on address until stopServer is called; the
+// caller, as the catalog's writer, publishes it first. threads <= 0 starts
+// one worker per hardware thread. False if the address could not be opened.
+bool runServer(const string& address, int threads, ServerStats& stats) {
+    stats = ServerStats{0, 0, 0, 0.0};
+#ifdef __linux__
+    if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+
+    // The wake pipe exists before the socket does, so a client that can
+    // connect can also stop the server
+    int wake[2];
+    int poller = epoll_create1(EPOLL_CLOEXEC);
+    if (poller < 0 || pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        cerr << "Error: Could not start the event loop: " << strerror(errno) << endl;
+        if (poller >= 0) close(poller);
+        return false;
+    }
+    serverWakeFd.store(wake[1]);
+    int listener = openServerSocket(address);
+    if (listener < 0) {
+        serverWakeFd.store(-1);
+        close(wake[0]);
+        close(wake[1]);
+        close(poller);
+        return false;
+    }
+    // The listener and the wake pipe are told apart from connections by
+    // these two addresses
+    static int listenerTag, wakeTag;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = &listenerTag;
+    epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event);
+    event.data.ptr = &wakeTag;
+    epoll_ctl(poller, EPOLL_CTL_ADD, wake[0], &event);
+
+    mutex queueLock;
+    condition_variable queueReady;
+    deque<ServerConnection*> ready;
+    bool stopping = false;
+    mutex connectionsLock;
+    unordered_map<int, ServerConnection*> connections;
+
+    auto closeConnection = [&](ServerConnection* connection) {
+        {
+            lock_guard<mutex> hold(connectionsLock);
+            connections.erase(connection->fd);
+        }
+        closeCartSession(connection->context.session);
+        close(connection->fd);
+        delete connection;
+    };
+
+    // Workers own a connection from the event that queued it until they
+    // re-arm or close it
+    auto work = [&](int reader) {
+        BatchStats served = {0, 0, 0.0};
+        for (;;) {
+            ServerConnection* connection;
+            {
+                unique_lock<mutex> hold(queueLock);
+                queueReady.wait(hold, [&]() { return stopping || !ready.empty(); });
+                if (stopping) break;
+                connection = ready.front();
+                ready.pop_front();
+            }
+            if (!serveConnection(*connection, reader, served)) {
+                closeConnection(connection);
+                continue;
+            }
+            size_t unsent = connection->output.used - connection->sent;
+            epoll_event rearm = {};
+            rearm.events = EPOLLONESHOT;
+            if (unsent > 0) rearm.events |= EPOLLOUT;
+            if (unsent < SERVER_OUTPUT_HIGH_WATER) rearm.events |= EPOLLIN;
+            rearm.data.ptr = connection;
+            lock_guard<mutex> handing(connection->handoff);
+            epoll_ctl(poller, EPOLL_CTL_MOD, connection->fd, &rearm);
+        }
+        releaseSnapshotReader(reader);
+        lock_guard<mutex> hold(queueLock);
+        stats.requests += served.commands;
+        stats.failed += served.failed;
+    };
+
+    // Each worker needs a snapshot reader slot of its own
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        int reader = claimSnapshotReader();
+        if (reader < 0) break;
+        workers.emplace_back(work, reader);
+    }
+    if (workers.empty()) {
+        cerr << "Error: No snapshot reader slots left for server workers" << endl;
+    } else {
+        cerr << "Server: " << idView.size() << " products on " << address << ", " << workers.size() << " workers"
+             << endl;
+    }
+
+    auto start = chrono::steady_clock::now();
+    epoll_event events[SERVER_MAX_EVENTS];
+    bool running = !workers.empty();
+    while (running) {
+        int count = epoll_wait(poller, events, SERVER_MAX_EVENTS, -1);
+        if (count < 0 && errno != EINTR) break;
+        for (int e = 0; e < count; ++e) {
+            if (events[e].data.ptr == &wakeTag) {
+                char byte;
+                running = read(wake[0], &byte, 1) != 1;
+            } else if (events[e].data.ptr == &listenerTag) {
+                for (;;) {
+                    int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0 && errno == EINTR) continue;
+                    if (fd < 0) break;
+                    // Answers are sent as soon as they are ready; on a Unix
+                    // socket this option simply does not apply
+                    int noDelay = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                    ServerConnection* connection = new ServerConnection{
+                        fd, CommandContext{nullptr, openCartSession(), PAGE_SIZE}, string(), 0,
+                        ExportWriter{nullptr, vector<char>(SERVER_OUTPUT_INITIAL), 0, 0, false}, 0, {}};
+                    {
+                        lock_guard<mutex> hold(connectionsLock);
+                        connections[fd] = connection;
+                    }
+                    epoll_event arm = {};
+                    arm.events = EPOLLIN | EPOLLONESHOT;
+                    arm.data.ptr = connection;
+                    epoll_ctl(poller, EPOLL_CTL_ADD, fd, &arm);
+                    stats.connections++;
+                }
+            } else {
+                ServerConnection* connection = static_cast<ServerConnection*>(events[e].data.ptr);
+                { lock_guard<mutex> settled(connection->handoff); }
+                lock_guard<mutex> hold(queueLock);
+                ready.push_back(connection);
+                queueReady.notify_one();
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> hold(queueLock);
+        stopping = true;
+    }
+    queueReady.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    serverWakeFd.store(-1);
+    for (auto& open : connections) {
+        closeCartSession(open.second->context.session);
+        close(open.first);
+        delete open.second;
+    }
+    close(listener);
+    close(wake[0]);
+    close(wake[1]);
+    close(poller);
+    sockaddr_storage storage;
+    socklen_t length;
+    if (serverAddress(address, storage, length) && storage.ss_family == AF_UNIX) unlink(address.c_str());
+    stats.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return true;
+#else
+    (void)address;
+    (void)threads;
+    cerr << "Error: The query server needs Linux (epoll)" << endl;
+    return false;
+#endif
+}
+
+// Safe to call from a signal handler: only writes a byte to the wake pipe
+void stopServer() {
+#ifdef __linux__
+    int fd = serverWakeFd.load();
+    if (fd >= 0) {
+        char byte = 1;
+        ssize_t written = write(fd, &byte, 1);
+        (void)written;
+    }
+#endif
+}
+
+void stopServerOnSignal(int) {
+    stopServer();
+}
+
+// One request of the load mix: half ID lookups, then filters, sorted pages,
+// a few name searches and cart actions, with a checkout now and then
+string randomLoadCommand(mt19937& rng, int maxID) {
+    static const char* names[] = {"mouse", "slim tent", "kettle", "headphones"};
+    static const char* categories[] = {"Electronics", "Furniture", "Kitchen", "Clothing", "Sports", "Office"};
+    static const char* sortKeys[] = {"id", "price", "rating", "name"};
+    unsigned pick = rng() % 100;
+    if (pick < 50) return "find PID" + to_string(1 + rng() % maxID) + "\n";
+    if (pick < 55) return string("name ") + names[rng() % 4] + "\n";
+    if (pick < 65) return string("category ") + categories[rng() % 6] + "\n";
+    if (pick < 75) {
+        int low = rng() % 990;
+        return "price " + to_string(low) + " " + to_string(low + 10) + "\n";
+    }
+    if (pick < 85) {
+        return string("sort ") + sortKeys[rng() % 4] + (rng() % 2 ? " desc " : " asc ") + to_string(rng() % 1000) + "\n";
+    }
+    if (pick < 96) return "add PID" + to_string(1 + rng() % maxID) + " " + to_string(1 + rng() % 5) + "\n";
+    if (pick < 99) return "cart\n";
+    return "checkout\n";
+}
+
+// Runs the load mix against a server for the given time. The product IDs are
+// learned from the server itself, so the generator needs no catalog. False if
+// the server cannot be reached or has no products.
+bool runLoadGenerator(const string& address, int connections, int depth, double seconds, LoadStats& stats) {
+    stats = LoadStats{connections, depth, 0, 0, 0.0, vector<float>()};
+#ifdef __linux__
+    auto sendAll = [](int fd, const string& data) {
+        for (size_t done = 0; done < data.size();) {
+            ssize_t put = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return false;
+            done += put;
+        }
+        return true;
+    };
+
+    // The highest ID bounds the random lookups
+    int probe = connectServer(address);
+    if (probe < 0) {
+        cerr << "Error: Could not connect to " << address << endl;
+        return false;
+    }
+    string answers;
+    char buffer[SERVER_READ_SIZE];
+    if (sendAll(probe, "limit 1\nsort id desc\n")) {
+        ssize_t got;
+        while (count(answers.begin(), answers.end(), '\n') < 2 && (got = recv(probe, buffer, sizeof(buffer), 0)) > 0) {
+            answers.append(buffer, got);
+        }
+    }
+    close(probe);
+    size_t found = answers.find("\"id\":\"");
+    int maxID = found == string::npos ? -1 : parseProductID(answers.substr(found + 6, answers.find('"', found + 6) - found - 6));
+    if (maxID <= 0) {
+        cerr << "Error: The server at " << address << " has no products" << endl;
+        return false;
+    }
+
+    mutex merge;
+    auto deadline = chrono::steady_clock::now() + chrono::microseconds(static_cast<long long>(seconds * 1e6));
+    auto client = [&](int index) {
+        int fd = connectServer(address);
+        if (fd < 0) return;
+        mt19937 rng(index + 1);
+        vector<float> latencies;
+        size_t failed = 0;
+        string requests, received;
+        vector<char> chunk(SERVER_READ_SIZE);
+        bool broken = false;
+        while (!broken && chrono::steady_clock::now() < deadline) {
+            requests.clear();
+            for (int d = 0; d < depth; ++d) {
+                requests += randomLoadCommand(rng, maxID);
+            }
+            auto sentAt = chrono::steady_clock::now();
+            if (!sendAll(fd, requests)) break;
+            for (int waiting = depth; waiting > 0;) {
+                ssize_t got = recv(fd, chunk.data(), chunk.size(), 0);
+                if (got <= 0) {
+                    broken = true;
+                    break;
+                }
+                auto now = chrono::steady_clock::now();
+                float latency = chrono::duration<float, micro>(now - sentAt).count();
+                received.append(chunk.data(), got);
+                size_t start = 0;
+                for (size_t end; (end = received.find('\n', start)) != string::npos; start = end + 1) {
+                    // "ok" follows "line" and "cmd", well inside the first 64 bytes
+                    size_t ok = received.find("\"ok\":", start);
+                    if (ok < end && ok < start + 64 && received.compare(ok + 5, 5, "false") == 0) failed++;
+                    latencies.push_back(latency);
+                    waiting--;
+                }
+                received.erase(0, start);
+            }
+        }
+        close(fd);
+        lock_guard<mutex> hold(merge);
+        stats.failed += failed;
+        stats.latencyUs.insert(stats.latencyUs.end(), latencies.begin(), latencies.end());
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> clients;
+    for (int c = 0; c < connections; ++c) {
+        clients.emplace_back(client, c);
+    }
+    for (thread& running : clients) {
+        running.join();
+    }
+    stats.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    stats.requests = stats.latencyUs.size();
+    sort(stats.latencyUs.begin(), stats.latencyUs.end());
+    return stats.requests > 0;
+#else
+    (void)address;
+    (void)seconds;
+    cerr << "Error: The load generator needs Linux" << endl;
+    return false;
+#endif
+}
+
+// Latency at the given percentile, in microseconds; stats.latencyUs is sorted
+float loadPercentile(const LoadStats& stats, double percentile) {
+    if (stats.latencyUs.empty()) return 0.0f;
+    size_t rank = static_cast<size_t>(percentile / 100.0 * stats.latencyUs.size());
+    return stats.latencyUs[min(rank, stats.latencyUs.size() - 1)];
+}
@@ -0,0 +1,739 @@
+// Catalog engine shared by the console application and the benchmark target:
+// the data structures, the global catalog state and every operation behind
+// the menus, batch mode and the query server. Nothing in it prompts for
+// input; the menus in main.cpp do that and call in here.
+#ifndef ECOMMERCE_H
+#define ECOMMERCE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <bitset>
+#include <new>
+#include <cstdlib>
+
+// The numeric key is the only identity the indexes compare; the "PIDnn"
+// text form is produced by formatProductID when a product is displayed.
+struct Product {
+    int id;
+    std::string name;
+    int categoryCode;   // index into categoryNames
+    float price;
+    float rating;
+};
+
+// AVL-balanced node: height is kept so every path stays O(log n) even when
+// IDs arrive in increasing order (which is always the case for new products).
+// The product itself lives in the columns; the node only holds its slot.
+struct Node {
+    int id;
+    int slot;
+    Node* left;
+    Node* right;
+    int height;
+};
+
+// Block allocator for tree nodes. Nodes are carved out of NODE_BLOCK_SIZE
+// blocks and recycled through a free list chained through left, so building
+// the tree for a million products costs a few hundred allocations instead of
+// a million, and a reload hands every block back at once.
+const size_t NODE_BLOCK_SIZE = 4096;
+
+struct NodePool {
+    std::vector<Node*> blocks;
+    size_t used;            // nodes handed out from the newest block
+    Node* freeList;
+    size_t live;            // nodes currently in use
+};
+
+// An AVL tree with 2^32 nodes is at most ~46 levels deep, so a fixed-size
+// stack is enough for the iterative insert and traversal routines.
+const int MAX_TREE_HEIGHT = 64;
+
+// One cart line per product. Lines refer to the catalog by ID and slot
+// instead of holding a Product copy. price is the unit price the line was
+// last priced at: the console cart keeps it current through the mutation API
+// and re-resolves slots after a reload; session carts take it (and the slot)
+// from the snapshot they were served from and reprice at checkout.
+struct CartLine {
+    int productID;
+    int slot;
+    int quantity;
+    float price;
+};
+
+// Lines in the order they were added (removing one moves the last line into
+// its place). index finds a product's line: an open-addressing table, a
+// power of two in size and at most half full, holding line number + 1 (0 is
+// an empty bucket). Unlike a node-based map it allocates nothing per line, so
+// a recycled cart refills without touching the heap. total and itemCount are
+// kept current by every cart change and by price changes in the catalog, so
+// nothing walks the lines except display and checkout.
+struct Cart {
+    std::vector<CartLine> lines;
+    std::vector<int> index;
+    double total;
+    long long itemCount;
+};
+
+const int MAX_CART_QUANTITY = 1000000;
+
+// Session carts for many concurrent shoppers. Sessions are spread over
+// CART_SHARD_COUNT shards by their key, each with its own lock, so threads
+// serving different shoppers rarely wait on each other. Carts released by
+// checkout-and-close or expiry go back to their shard's spare list with
+// their capacity intact, and a shard drops sessions idle for longer than
+// cartIdleTimeout whenever it is touched after CART_SWEEP_INTERVAL.
+const int CART_SHARD_COUNT = 64;
+const size_t SPARE_CARTS_PER_SHARD = 64;
+const size_t SPARE_CART_MAX_LINES = 1024;     // larger carts are freed, not kept
+const std::chrono::seconds CART_SWEEP_INTERVAL(60);
+
+struct CartSession {
+    Cart* cart;
+    std::chrono::steady_clock::time_point lastUsed;
+};
+
+struct alignas(64) CartShard {
+    std::mutex lock;
+    std::unordered_map<uint64_t, CartSession> sessions;
+    std::vector<Cart*> spareCarts;
+    std::chrono::steady_clock::time_point lastSweep;
+};
+
+// What a session cart adds up to; sessionCheckout reprices it first
+struct CartReceipt {
+    size_t lines;
+    long long items;
+    double total;
+    size_t dropped;     // lines whose product has left the catalog
+};
+
+// Hands out product numbers in O(1). The high-water mark is saved as a trailer
+// in products.dat, so numbers are never reused and findMaxID is only needed
+// when migrating files written before the trailer existed.
+struct IDAllocator {
+    int nextID;
+};
+
+// Products per page when browsing the sorted list
+const size_t PAGE_SIZE = 10;
+
+// runQuery switches to a bitmap scan of the attribute columns once its most
+// selective index would still yield more than 1/ATTRIBUTE_SCAN_SHARE of the slots
+const size_t ATTRIBUTE_SCAN_SHARE = 16;
+
+// Trailer tag that legacy (version 1) files carry after the product
+// records: "NXID" followed by nextID
+const char ID_TRAILER_TAG[4] = {'N', 'X', 'I', 'D'};
+
+// products.dat version 2: a fixed header, then sections that can be used in
+// place from a read-only mapping. Records are fixed width and refer to a
+// shared string heap; the index sections hold the sorted views and posting
+// lists as they were at save time, so loading copies them instead of
+// re-sorting and re-tokenizing. Integers use the writer's byte order, which
+// the reader checks through endianTag. Every section starts 8-byte aligned.
+const char CATALOG_MAGIC[8] = {'E', 'C', 'A', 'T', 'A', 'L', 'O', 'G'};
+const uint32_t CATALOG_VERSION = 2;
+const uint32_t CATALOG_ENDIAN_TAG = 0x01020304;
+const int CATALOG_MAX_SECTIONS = 16;
+
+enum CatalogSection {
+    SECTION_RECORDS,            // CatalogRecord[recordCount], in ID order
+    SECTION_STRINGS,            // string heap: names, category names, name tokens
+    SECTION_CATEGORIES,         // CatalogString[categoryCount]
+    SECTION_VIEW_ID,            // int32[recordCount] record numbers per sort key
+    SECTION_VIEW_PRICE,
+    SECTION_VIEW_RATING,
+    SECTION_VIEW_NAME,
+    SECTION_CATEGORY_POSTINGS,  // posting table, one list per category
+    SECTION_NAME_TOKENS,        // posting table keyed by token (product IDs)
+    SECTION_TRIGRAMS,           // posting table keyed by trigram (record numbers)
+    SECTION_COUNT
+};
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag;
+    uint32_t recordCount;
+    uint32_t categoryCount;
+    int32_t nextID;
+    uint32_t sectionCount;
+    uint64_t sectionOffset[CATALOG_MAX_SECTIONS];
+    uint64_t sectionSize[CATALOG_MAX_SECTIONS];
+};
+
+struct CatalogRecord {
+    int32_t id;
+    int32_t categoryCode;   // index into the file's category table
+    uint32_t nameOffset;    // into the string heap
+    uint32_t nameLength;
+    float price;
+    float rating;
+};
+
+struct CatalogString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// A posting table section is a uint64 list count, the list headers, then one
+// int32 pool that the headers index into
+struct CatalogPostingList {
+    uint32_t key;           // token heap offset, or the packed trigram
+    uint32_t keyLength;     // token length; 0 for categories and trigrams
+    uint32_t start;
+    uint32_t count;
+};
+
+// products.dat.wal: every add, update and remove made since products.dat was
+// written, replayed on top of it at startup. A LogFileHeader, then records of
+// a LogRecordHeader followed by its payload: a LogRecord and the name and
+// category text. The checksum covers the payload, so a record torn by a
+// crash is detected and dropped. Once the log passes LOG_COMPACT_BYTES it is
+// folded into a fresh snapshot.
+const char LOG_MAGIC[8] = {'E', 'C', 'W', 'A', 'L', 'O', 'G', '1'};
+const uint32_t LOG_VERSION = 1;
+const uint64_t LOG_COMPACT_BYTES = 256 << 10;
+
+enum LogOp { LOG_ADD = 1, LOG_UPDATE = 2, LOG_REMOVE = 3 };
+
+struct LogFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag;     // CATALOG_ENDIAN_TAG
+};
+
+struct LogRecordHeader {
+    uint32_t length;        // payload bytes
+    uint32_t checksum;      // CRC-32 of the payload
+};
+
+struct LogRecord {
+    uint32_t op;            // LogOp
+    int32_t id;
+    float price;
+    float rating;
+    uint32_t nameLength;
+    uint32_t categoryLength;
+};
+
+// The open log. Mutations are encoded into pending and reach the disk with
+// one write and one fsync per batch in flushMutationLog.
+struct MutationLog {
+    FILE* file;             // nullptr while loading or replaying, so nothing is re-logged
+    std::string catalogPath;     // the snapshot this log applies to
+    std::string path;
+    std::string pending;         // records not yet written
+    uint64_t size;          // bytes in the log, pending included
+    long compactor;         // pid of a running background compaction, or 0
+    bool loadFailed;        // catalogPath could not be loaded, so nothing may overwrite it
+};
+
+// Sequential file writer for the snapshot and CSV exports. Output is staged
+// in one reusable buffer and written in EXPORT_BUFFER_SIZE blocks, so an
+// export needs O(buffer) memory however large the catalog is.
+const size_t EXPORT_BUFFER_SIZE = 1 << 20;
+
+struct ExportWriter {
+    FILE* file;
+    std::vector<char> buffer;
+    size_t used;            // bytes staged in buffer
+    uint64_t flushed;       // bytes written to the file before buffer
+    bool failed;
+};
+
+// Supplier feed formats accepted by importProductsFromFile: CSV with a
+// name,category,price,rating header (any column order, extra columns
+// ignored) or no header and those four columns, and JSON lines with objects
+// holding the same keys. Quoted CSV fields may not contain line breaks.
+enum ImportFormat { IMPORT_CSV, IMPORT_JSONL };
+
+// One slice of an import file, parsed by a single worker thread. Products
+// carry codes into the chunk's own categories list until the merge interns
+// them, so workers never touch the shared category dictionary.
+struct ImportChunk {
+    const char* begin;
+    const char* end;
+    std::vector<Product> products;
+    std::vector<std::string> categories;
+    size_t rows;            // non-blank lines
+    size_t rejected;        // lines that failed parsing or validation
+};
+
+// A feed of at least 1/IMPORT_REBUILD_SHARE of the catalog rebuilds every
+// index in one bulk load instead of adding its products one at a time
+const size_t IMPORT_REBUILD_SHARE = 8;
+
+struct ImportStats {
+    size_t rows;
+    size_t imported;
+    size_t rejected;
+    int threads;
+    double parseMs;
+    double insertMs;
+    double saveMs;
+    size_t rebuildRows;     // smallest feed that rebuilds the catalog
+    bool rebuilt;
+    bool saved;             // made durable by the log or a snapshot
+};
+
+// Batch mode (--batch): one command per line, answered by one JSON object
+// per line with nothing else on stdout. Commands:
+//   find <id>                 name <text>            category <name>
+//   price <min> <max>         rating <min> <max>     sort <id|price|rating|name> [asc|desc] [offset]
+//   add <id> [quantity]       qty <id> <quantity>    cart
+//   checkout                  save                   limit <n>   (products per answer, 0 = all)
+// Blank lines and lines starting with # are skipped.
+struct BatchStats {
+    size_t commands;
+    size_t failed;          // malformed commands and actions that could not be done
+    double elapsedMs;
+};
+
+// Read-only view of a whole file: mmap'ed where available, otherwise read
+// into buffer
+struct MappedFile {
+    const char* data;
+    size_t size;
+    std::vector<char> buffer;
+};
+
+// Global variables, defined in ecommerce.cpp
+extern Node* root;
+extern IDAllocator idAllocator;
+extern Cart cart;
+
+extern CartShard cartShards[CART_SHARD_COUNT];
+extern std::atomic<uint64_t> cartSessionCounter;
+extern std::chrono::seconds cartIdleTimeout;
+
+extern NodePool nodePool;
+
+// Single product store, one array per field. Products are addressed by slot
+// number everywhere else; slots freed by removeProduct are reused by the next
+// addProduct. A price scan reads 4 bytes per product instead of a whole
+// record, and productAt assembles a Product where one is needed (display,
+// the cart, the mutation log).
+// Names are packed back to back in nameArena, so loading a catalog allocates
+// no per-product strings; a changed or removed name leaves dead bytes behind
+// until they outweigh the live ones and the arena is repacked.
+// prefix packs the first eight bytes big-endian (zero padded), so comparing
+// prefixes orders names like string::compare; only names sharing all eight
+// bytes need to look into the arena.
+struct NameSpan {
+    uint64_t prefix;
+    size_t offset;
+    size_t length;
+};
+
+struct ProductColumns {
+    std::vector<int> id;             // 0 marks a free slot
+    std::vector<int> categoryCode;
+    std::vector<float> price;
+    std::vector<float> rating;
+    std::vector<NameSpan> name;      // sort prefix and place in nameArena
+    std::vector<char> nameArena;
+    size_t deadNameBytes;
+};
+extern ProductColumns columns;
+extern std::vector<int> freeSlots;
+
+// One implementation of the column filter kernels. Each writes a selection
+// bitmap for values[0, count): bit i % 64 of mask[i / 64] is set when value i
+// passes, and bits past count are left zero. Free slots hold NaN prices and
+// ratings and category -1 (see clearColumns), so they never pass.
+struct FilterKernels {
+    const char* name;
+    void (*rangeMask)(const float* values, size_t count, float low, float high, uint64_t* mask);
+    void (*equalMask)(const int* values, size_t count, int target, uint64_t* mask);
+};
+
+// Sorted permutation views over the store, one per sort key. Each holds
+// slot numbers ordered ascending by its key with ties broken by ID; descending
+// order reads a view backwards. The mutation API keeps all of them up to date,
+// so the ID view always stays valid for binarySearchByID.
+enum SortKey { SORT_BY_ID, SORT_BY_PRICE, SORT_BY_RATING, SORT_BY_NAME, SORT_KEY_COUNT };
+extern std::vector<int> sortedViews[SORT_KEY_COUNT];
+extern std::vector<int>& idView;
+
+// Name indexes; see nameIndex and trigramIndex below
+typedef std::map<std::string, std::vector<int>> TokenIndex;
+typedef std::unordered_map<uint32_t, std::vector<int>> TrigramIndex;
+
+// Immutable copy of the catalog for reader threads. The menu thread is the
+// only writer: it changes the live structures through the mutation API and
+// then publishes a new snapshot, which readers pick up without taking a lock.
+// Parts that did not change since the last publish are shared with the
+// previous snapshot instead of copied, column by column, so a price change
+// copies the price column and view but not the names. The name indexes are
+// shared the same way: the live catalog copies them on its first name change
+// after a publish, so a publish never does.
+struct CatalogSnapshot {
+    uint64_t version;
+    std::shared_ptr<const std::vector<int>> id;               // the columns, as in ProductColumns
+    std::shared_ptr<const std::vector<int>> categoryCode;
+    std::shared_ptr<const std::vector<float>> price;
+    std::shared_ptr<const std::vector<float>> rating;
+    std::shared_ptr<const std::vector<NameSpan>> name;
+    std::shared_ptr<const std::vector<char>> nameArena;
+    std::shared_ptr<const std::vector<int>> views[SORT_KEY_COUNT];
+    std::shared_ptr<const std::vector<std::string>> categoryNames;
+    std::shared_ptr<const TokenIndex> nameIndex;
+    std::shared_ptr<const TrigramIndex> trigramIndex;
+};
+
+// Which parts of the live catalog changed since the last publish: bit k for
+// sortedViews[k], then one bit per column (names and their arena together)
+// and one for the category names
+const unsigned SNAPSHOT_IDS = 1u << SORT_KEY_COUNT;
+const unsigned SNAPSHOT_CATEGORY_CODES = SNAPSHOT_IDS << 1;
+const unsigned SNAPSHOT_PRICES = SNAPSHOT_IDS << 2;
+const unsigned SNAPSHOT_RATINGS = SNAPSHOT_IDS << 3;
+const unsigned SNAPSHOT_NAMES = SNAPSHOT_IDS << 4;
+const unsigned SNAPSHOT_CATEGORIES = SNAPSHOT_IDS << 5;
+const unsigned SNAPSHOT_ALL = (SNAPSHOT_IDS << 6) - 1;
+
+// Epoch-based reclamation. A reader announces the current epoch before it
+// loads the published pointer and clears it when done; a replaced snapshot
+// is retired with the epoch that followed its replacement and deleted once
+// every active reader has announced that epoch or a later one. Each reader
+// owns one cache line, so readers never write to shared memory.
+const int MAX_SNAPSHOT_READERS = 64;
+
+struct alignas(64) SnapshotReader {
+    std::atomic<bool> claimed;
+    std::atomic<uint64_t> epoch;     // 0 while outside a snapshot
+};
+
+struct RetiredSnapshot {
+    const CatalogSnapshot* snapshot;
+    uint64_t epoch;
+};
+
+// A conjunction of filters for runQuery; a filter that is left unset matches
+// every product. Results are ordered by sortKey (ties by ID).
+struct ProductQuery {
+    std::string nameContains = "";   // case-insensitive substring
+    std::string category = "";       // exact category text
+    bool hasPriceRange = false;
+    float minPrice = 0.0f;
+    float maxPrice = 0.0f;
+    bool hasRatingRange = false;
+    float minRating = 0.0f;
+    float maxRating = 0.0f;
+    SortKey sortKey = SORT_BY_ID;
+    bool ascending = true;
+    size_t offset = 0;          // results to skip, for pagination
+    size_t limit = 0;           // results to return; 0 = all
+};
+
+// Where runQuery can take its initial candidates from
+enum QuerySource { SOURCE_ALL, SOURCE_CATEGORY, SOURCE_PRICE, SOURCE_RATING, SOURCE_NAME };
+
+// How many products a predicate's index would yield. Exact for category,
+// price and rating; for names it is the shortest trigram list, an upper bound.
+struct PredicateEstimate {
+    QuerySource source;
+    size_t estimate;
+};
+
+// Where a command runs: the live catalog and the console cart for --batch,
+// or a snapshot and a session cart for a server connection
+struct CommandContext {
+    const CatalogSnapshot* snapshot;    // nullptr for the live catalog
+    uint64_t session;
+    size_t limit;                       // products per answer, 0 for all
+};
+
+// Query server (--serve). One epoll thread accepts connections and hands each
+// readable one to a pool of worker threads. Requests are batch mode command
+// lines, and a client may pipeline any number of them before reading the
+// answers, which come back in request order.
+const int SERVER_DEFAULT_PORT = 7070;
+const size_t SERVER_READ_SIZE = 64 << 10;           // bytes read per event
+const size_t SERVER_MAX_LINE = 64 << 10;            // a longer request closes the connection
+const size_t SERVER_OUTPUT_HIGH_WATER = 1 << 20;    // stop reading while this much is unsent
+const size_t SERVER_OUTPUT_INITIAL = 4096;
+const int SERVER_MAX_EVENTS = 256;
+
+// A client connection. It is registered with EPOLLONESHOT, so after each
+// event exactly one worker owns it until the worker re-arms it; answers stay
+// in order without a lock.
+struct ServerConnection {
+    int fd;
+    CommandContext context;     // session is this client's cart; snapshot is set per event
+    std::string input;               // received bytes after the last complete line
+    size_t lineNumber;          // lines received so far
+    ExportWriter output;        // answers not yet sent; without a file it only grows
+    size_t sent;                // bytes of output already sent
+    // Held by the owner while it re-arms, and taken by the epoll thread
+    // before it queues the connection again. epoll already orders one owner
+    // before the next, but only the lock makes that visible to the memory
+    // model (and to thread sanitizers).
+    std::mutex handoff;
+};
+
+struct ServerStats {
+    size_t connections;
+    size_t requests;
+    size_t failed;
+    double elapsedMs;
+};
+
+// Load generator (--load): each connection sends depth requests at once and
+// waits for all the answers before sending the next round
+struct LoadStats {
+    int connections;
+    int depth;
+    size_t requests;
+    size_t failed;              // answers with "ok":false
+    double elapsedMs;
+    std::vector<float> latencyUs;    // per answer, from its round being sent
+};
+
+// Category dictionary: each distinct category string is stored once and
+// products carry its code. Codes are never reassigned, even across reloads,
+// so Product copies taken before a reload stay valid. categoryPostings[code] lists
+// the slots of that category's products in ID order.
+extern std::vector<std::string> categoryNames;
+extern std::map<std::string, int> categoryCodes;
+extern std::vector<std::vector<int>> categoryPostings;
+
+// Inverted index over product names: lowercase token -> sorted product IDs.
+// The map is ordered so all tokens sharing a prefix are adjacent. Both name
+// indexes are held through shared pointers that snapshots may share, so
+// changes go through writableNameIndex and writableTrigramIndex.
+extern std::shared_ptr<TokenIndex> nameIndex;
+
+// Trigram index over lowercase product names: packed 3-byte gram -> sorted
+// slots. Any name containing a query contains all of its
+// trigrams, so intersecting their postings gives a candidate set to verify.
+// Slots (not IDs) let verification read the name without a tree lookup.
+extern std::shared_ptr<TrigramIndex> trigramIndex;
+
+// What the name searches read: the live catalog or a snapshot of it
+struct NameSearchSource {
+    const TokenIndex* tokens;
+    const TrigramIndex* trigrams;
+    const std::vector<int>* idView;          // slots in ID order
+    const std::vector<int>* ids;             // the ID column
+    const std::vector<NameSpan>* names;
+    const char* nameArena;
+};
+
+// View and direction selected by the last sort, shown by displaySortedList
+extern SortKey displayKey;
+extern bool displayAscending;
+
+extern MutationLog mutationLog;
+
+// Published snapshot and its reclamation state; see CatalogSnapshot
+extern std::atomic<const CatalogSnapshot*> publishedSnapshot;
+extern std::atomic<uint64_t> snapshotEpoch;
+extern SnapshotReader snapshotReaders[MAX_SNAPSHOT_READERS];
+extern std::vector<RetiredSnapshot> retiredSnapshots;
+extern unsigned snapshotStale;
+
+// Write end of the pipe that wakes runServer's event loop to stop it; -1
+// while no server is running. A signal handler may write to it.
+extern std::atomic<int> serverWakeFd;
+
+// Function prototypes
+int generateProductNumber();
+int reserveProductIDs(int count);
+int peekNextProductNumber();
+std::string formatProductID(int number);
+int parseProductID(const std::string& input);
+int findMaxID(Node* root);
+Node* createNode(int id, int slot);
+void freeNode(Node* node);
+void releaseNodePool();
+int nodeHeight(Node* node);
+void updateHeight(Node* node);
+Node* rotateLeft(Node* node);
+Node* rotateRight(Node* node);
+Node* rebalance(Node* node);
+Node* insertNode(Node* root, int id, int slot);
+Node* searchNode(Node* root, int targetID);
+void destroyTree(Node* root);
+Node* buildTreeFromSorted(const std::vector<int>& slots, int first, int last);
+void bulkLoadProducts(std::vector<Product>& products);
+Node* deleteNode(Node* root, int targetID);
+bool isValidNameOrCategory(const std::string& str);
+bool keyLess(SortKey key, const Product& a, const Product& b);
+bool slotLess(SortKey key, int a, int b);
+int compareSlotNames(int a, int b);
+void insertIntoView(SortKey key, int slot);
+void eraseFromView(SortKey key, int slot);
+void storeColumns(int slot, const Product& product);
+void clearColumns(int slot);
+void resizeColumns(size_t size);
+Product productAt(int slot);
+std::vector<Product> copyProducts();
+void packNameArena();
+const char* columnName(int slot);
+uint64_t namePrefix(const char* name, size_t length);
+void rebuildSortedViews();
+bool addProduct(const Product& p);
+bool updateProduct(const Product& p);
+bool removeProduct(int id);
+void publishSnapshot();
+void refreshSnapshot();
+void reclaimSnapshots();
+int claimSnapshotReader();
+void releaseSnapshotReader(int reader);
+const CatalogSnapshot* enterSnapshot(int reader);
+void leaveSnapshot(int reader);
+int snapshotFind(const CatalogSnapshot& snapshot, int id);
+Product snapshotProduct(const CatalogSnapshot& snapshot, int slot);
+std::vector<int> snapshotQuery(const CatalogSnapshot& snapshot, const ProductQuery& query);
+int binarySearchByID(const std::vector<int>& view, int targetID);
+std::vector<std::string> tokenizeName(const std::string& name);
+bool nextNameToken(const std::string& name, size_t& pos, std::string& token);
+void indexProductName(int id, int slot, const std::string& name);
+void unindexProductName(int id, int slot, const std::string& name);
+std::vector<int> searchNameIndex(const std::string& query);
+std::vector<int> searchNameIndex(const NameSearchSource& source, const std::string& query);
+NameSearchSource liveNameSource();
+NameSearchSource snapshotNameSource(const CatalogSnapshot& snapshot);
+TokenIndex& writableNameIndex();
+TrigramIndex& writableTrigramIndex();
+std::vector<int> cascadeNameSearch(const NameSearchSource& source, const std::string& query, const char*& match);
+std::vector<uint32_t> nameTrigrams(const std::string& text);
+void nameTrigrams(const std::string& text, std::vector<uint32_t>& grams);
+int internCategory(const std::string& category);
+int findCategory(const std::string& category);
+const std::string& categoryName(int code);
+void indexProductCategory(int slot);
+void unindexProductCategory(int slot);
+bool containsIgnoreCase(const std::string& text, const std::string& lowerNeedle);
+bool containsIgnoreCase(const char* text, size_t length, const std::string& lowerNeedle);
+bool trigramPostingLists(const TrigramIndex& index, const std::vector<uint32_t>& grams,
+                         std::vector<const std::vector<int>*>& lists);
+void intersectSlotLists(std::vector<int>& candidates, const std::vector<const std::vector<int>*>& lists, size_t first);
+std::vector<int> substringSearchNames(const std::string& query);
+std::vector<int> substringSearchNames(const NameSearchSource& source, const std::string& query);
+int boundedEditDistance(const std::string& a, const std::string& b, int maxEdits);
+std::vector<int> fuzzySearchNames(const std::string& query, int maxEdits);
+std::vector<int> fuzzySearchNames(const NameSearchSource& source, const std::string& query, int maxEdits);
+std::pair<int, int> viewRange(SortKey key, float low, float high);
+std::vector<FilterKernels> supportedFilterKernels();
+const FilterKernels& activeFilterKernels();
+void rangeMaskScalar(const float* values, size_t count, float low, float high, uint64_t* mask);
+void equalMaskScalar(const int* values, size_t count, int target, uint64_t* mask);
+void andMask(uint64_t* into, const uint64_t* mask, size_t words);
+size_t countMask(const uint64_t* mask, size_t words);
+void maskToSlots(const uint64_t* mask, size_t words, std::vector<int>& slots);
+std::vector<int> scanAttributeColumns(const ProductQuery& query, int code);
+bool prefersAttributeScan(const ProductQuery& query, const std::vector<PredicateEstimate>& plan);
+std::vector<PredicateEstimate> estimateSelectivity(const ProductQuery& query);
+std::vector<int> runQuery(const ProductQuery& query);
+void selectTopSlots(std::vector<int>& slots, SortKey key, bool ascending, size_t count);
+std::vector<int> sortedPage(SortKey key, bool ascending, size_t offset, size_t limit);
+size_t cartBucket(int productID, size_t buckets);
+int findCartLine(const Cart& in, int productID);
+void placeCartLine(Cart& in, size_t line);
+void rebuildCartIndex(Cart& in, size_t buckets);
+bool addCartLine(Cart& into, int productID, int slot, float price, int quantity);
+bool setCartLineQuantity(Cart& into, int productID, int quantity);
+void eraseCartLine(Cart& from, size_t index);
+void resetCart(Cart& target);
+bool addToCart(int slot, int quantity);
+bool setCartQuantity(int productID, int quantity);
+bool isInCart(int productID);
+void clearCart();
+void relinkCart();
+void cartPriceChanged(int productID, float newPrice);
+void cartProductRemoved(int productID);
+uint64_t openCartSession();
+bool closeCartSession(uint64_t session);
+bool sessionAddToCart(const CatalogSnapshot& snapshot, uint64_t session, int productID, int quantity);
+bool sessionSetQuantity(uint64_t session, int productID, int quantity);
+bool sessionCartSummary(uint64_t session, CartReceipt& summary);
+bool sessionCartLines(uint64_t session, std::vector<CartLine>& lines, CartReceipt& summary);
+int sessionLineQuantity(uint64_t session, int productID);
+bool sessionCheckout(const CatalogSnapshot& snapshot, uint64_t session, CartReceipt& receipt);
+size_t expireIdleCarts(std::chrono::steady_clock::time_point cutoff);
+CartShard& cartShardOf(uint64_t session);
+void recycleCart(CartShard& shard, Cart* spent);
+size_t sweepCartShard(CartShard& shard, std::chrono::steady_clock::time_point cutoff);
+CartSession* touchCartSession(CartShard& shard, uint64_t session);
+bool saveProductsToFile(const std::string& filename);
+bool exportProductsToCSV(const std::string& filename);
+bool openExport(ExportWriter& out, const std::string& filename);
+void writeExport(ExportWriter& out, const void* data, size_t size);
+void writeExportNumber(ExportWriter& out, float value);
+void flushExport(ExportWriter& out);
+void padExport(ExportWriter& out);
+uint64_t exportPosition(const ExportWriter& out);
+bool rewindExport(ExportWriter& out);
+bool closeExport(ExportWriter& out);
+bool loadProductsFromFile(const std::string& filename);
+void saveLegacyProductsToFile(const std::string& filename);
+void loadLegacyProductsFromFile(const std::string& filename);
+bool loadCatalogImage(const MappedFile& file);
+bool mapFile(const std::string& filename, MappedFile& file);
+void unmapFile(MappedFile& file);
+void clearCatalog();
+size_t openCatalog(const std::string& filename);
+bool openMutationLog(const std::string& catalogFilename);
+bool startMutationLog(bool truncate);
+void closeMutationLog();
+void logMutation(LogOp op, const Product& p);
+bool flushMutationLog();
+bool syncMutationLog();
+size_t replayMutationLog(const std::string& path);
+bool compactCatalog(bool wait);
+bool saveCatalog();
+std::string catalogFilePath();
+bool finishCompaction(bool wait);
+bool processIsSingleThreaded();
+uint32_t computeCRC32(const char* data, size_t size);
+bool syncPath(const std::string& path);
+std::string directoryOf(const std::string& path);
+bool fileExists(const std::string& path);
+bool importProductsFromFile(const std::string& filename, int threads, ImportStats& stats);
+void parseImportChunk(ImportChunk& chunk, ImportFormat format, const int* columns);
+bool splitCSVLine(const char* begin, const char* end, std::vector<std::string>& fields);
+bool parseJSONLine(const char* begin, const char* end, std::string* values);
+bool parseNumberField(const std::string& text, float& value);
+bool runBatch(std::istream& in, FILE* output, BatchStats& stats);
+bool runCommand(CommandContext& context, const std::string& line, size_t lineNumber, ExportWriter& out);
+void writeBatchProducts(ExportWriter& out, const CatalogSnapshot* snapshot, const std::vector<int>& slots, size_t limit);
+void writeJSONString(ExportWriter& out, const char* text, size_t length);
+#ifdef __linux__
+int openServerSocket(const std::string& address);
+int connectServer(const std::string& address);
+bool serveConnection(ServerConnection& connection, int reader, BatchStats& stats);
+#endif
+bool runServer(const std::string& address, int threads, ServerStats& stats);
+void stopServer();
+void stopServerOnSignal(int signal);
+std::string randomLoadCommand(std::mt19937& rng, int maxID);
+bool runLoadGenerator(const std::string& address, int connections, int depth, double seconds, LoadStats& stats);
+float loadPercentile(const LoadStats& stats, double percentile);
+
+#endif
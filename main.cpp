@@ -1,50 +1,15 @@
-#include <iostream>
-#include <string>
-#include <vector>
-#include <algorithm>
-#include <cctype>
-#include <limits>
-#include <iomanip>
-#include <fstream>
-using namespace std;
+#include "ecommerce.h"
+#include "catalog_generator.h"
+#include <csignal>
 
-struct Product {
-    string ID;        
-    string name;
-    string category;
-    float price;
-    float rating;
-};
-
-struct Node {
-    Product data;
-    Node* left;
-    Node* right;
-};
-
-struct CartNode {
-    Product data;
-    CartNode* next;
-};
-
-// Global variables
-Node* root = nullptr;
-CartNode* cartHead = nullptr;
-vector<Product> sortedProducts;
+using namespace std;
 
 // Function prototypes
-int generateProductNumber(Node* root);
-string formatProductID(int number);
-string normalizeID(string id);
-int extractIDNumber(const string& id);
-int findMaxID(Node* root);
-Node* createNode(Product p);
-Node* insertNode(Node* root, Product p);
-Node* searchNode(Node* root, const string& targetID);
 void inOrderTraversal(Node* root);
-void toArray(Node* root, vector<Product>& arr);
-bool isValidNameOrCategory(const string& str);
-Node* addProducts(Node* root);
+void readProductDetails(Product& p);
+void addProducts();
+void editProduct();
+void deleteProduct();
 void displayHeader();
 void mainMenu();
 void productManagementMenu();
@@ -52,25 +17,29 @@ void searchFilterMenu();
 void sortingMenu();
 void cartMenu();
 void displayAllProducts();
-int binarySearchByID(const vector<Product>& arr, const string& targetID);
 void searchByName();
+void printNameMatches(const vector<int>& ids);
 void filterByCategory();
 void filterByPriceRange();
+void filterByRatingRange();
+bool displaySortedPage(size_t page);
+void browseSortedList();
+void combinedQuery();
 void sortByPrice(bool ascending);
 void sortByRating(bool ascending);
 void sortByName(bool ascending);
+void sortByID();
 void displaySortedList();
 void addProductToCart();
 void viewCart();
 void checkout();
-CartNode* createCartNode(Product p);
-void addToCart(Product product);
-bool isInCart(CartNode* head, const string& productID);
-void validateCart(string productID);
+void changeCartQuantity();
+void validateCart(int productID, int quantity);
 void clearScreen();
 void displayThankYou();
-void saveProductsToFile(const string& filename);
-void loadProductsFromFile(const string& filename);
+void printImportStats(const ImportStats& stats);
+void printLoadStats(const LoadStats& stats);
+void importProductsMenu();
 void saveMenu();
 void searchByID();
 void pressEnterToContinue();
@@ -78,17 +47,109 @@ void pressEnterToContinue();
 
 
 
-int main() {
-    // Load products from file at startup
-    loadProductsFromFile("products.dat");
+int main(int argc, char* argv[]) {
+    // Non-interactive CSV export: ./ecommerce --export <file>
+    if (argc > 2 && string(argv[1]) == "--export") {
+        openCatalog("products.dat");
+        if (mutationLog.loadFailed) return 1;
+        bool exported = exportProductsToCSV(argv[2]);
+        closeMutationLog();
+        return exported ? 0 : 1;
+    }
+
+    // Synthetic feed, written as CSV without touching products.dat:
+    // ./ecommerce --generate <file> <count> [seed] [uniform|skewed]
+    if (argc > 3 && string(argv[1]) == "--generate") {
+        CatalogDistribution distribution = DISTRIBUTION_UNIFORM;
+        if (argc > 5 && !parseCatalogDistribution(argv[5], distribution)) {
+            cerr << "Error: Distribution must be uniform or skewed" << endl;
+            return 1;
+        }
+        int count = max(0, atoi(argv[3]));
+        unsigned seed = argc > 4 ? static_cast<unsigned>(strtoul(argv[4], nullptr, 10)) : 1;
+        loadGeneratedCatalog(distribution == DISTRIBUTION_SKEWED ? skewedCatalogSpec(count, seed)
+                                                                 : defaultCatalogSpec(count, seed));
+        return exportProductsToCSV(argv[2]) ? 0 : 1;
+    }
+
+    // Non-interactive command stream: ./ecommerce --batch [file], stdin by default
+    if (argc > 1 && string(argv[1]) == "--batch") {
+        ios::sync_with_stdio(false);
+        ifstream file;
+        if (argc > 2 && string(argv[2]) != "-") {
+            file.open(argv[2]);
+            if (!file) {
+                cerr << "Error: Could not open " << argv[2] << endl;
+                return 1;
+            }
+        }
+        openCatalog("products.dat");
+        if (mutationLog.loadFailed) return 1;
+        BatchStats stats;
+        bool written = runBatch(argc > 2 && string(argv[2]) != "-" ? file : cin, stdout, stats);
+        closeMutationLog();
+        cerr << "Batch: " << stats.commands << " commands (" << stats.failed << " failed) in " << fixed
+             << setprecision(1) << stats.elapsedMs << " ms, " << setprecision(0)
+             << (stats.elapsedMs > 0 ? stats.commands / stats.elapsedMs * 1000.0 : 0.0) << " commands/s" << endl;
+        return written ? 0 : 1;
+    }
+
+    // Query server: ./ecommerce --serve [port|socket path] [threads], until Ctrl+C
+    if (argc > 1 && string(argv[1]) == "--serve") {
+        openCatalog("products.dat");
+        if (mutationLog.loadFailed) return 1;
+        publishSnapshot();
+#ifdef __linux__
+        signal(SIGINT, stopServerOnSignal);
+        signal(SIGTERM, stopServerOnSignal);
+#endif
+        ServerStats stats;
+        bool served = runServer(argc > 2 ? argv[2] : to_string(SERVER_DEFAULT_PORT), argc > 3 ? atoi(argv[3]) : 0,
+                                stats);
+        closeMutationLog();
+        if (served) {
+            cerr << "Server: " << stats.requests << " requests (" << stats.failed << " failed) on "
+                 << stats.connections << " connections in " << fixed << setprecision(1)
+                 << stats.elapsedMs / 1000.0 << " s" << endl;
+        }
+        return served ? 0 : 1;
+    }
+
+    // Load generator for a running server:
+    // ./ecommerce --load [port|socket path] [connections] [depth] [seconds]
+    if (argc > 1 && string(argv[1]) == "--load") {
+        LoadStats stats;
+        bool ran = runLoadGenerator(argc > 2 ? argv[2] : to_string(SERVER_DEFAULT_PORT),
+                                    argc > 3 ? max(1, atoi(argv[3])) : 8, argc > 4 ? max(1, atoi(argv[4])) : 1,
+                                    argc > 5 ? atof(argv[5]) : 10.0, stats);
+        if (ran) printLoadStats(stats);
+        return ran ? 0 : 1;
+    }
+
+    // Non-interactive feed import: ./ecommerce --import <file> [threads]
+    if (argc > 2 && string(argv[1]) == "--import") {
+        openCatalog("products.dat");
+        if (mutationLog.loadFailed) return 1;
+        ImportStats stats;
+        bool imported = importProductsFromFile(argv[2], argc > 3 ? atoi(argv[3]) : 0, stats);
+        if (imported) printImportStats(stats);
+        closeMutationLog();
+        return imported ? 0 : 1;
+    }
+
+    // Load the last snapshot and replay the changes logged since. A snapshot
+    // that cannot be loaded is left alone for the user to restore.
+    size_t replayed = openCatalog("products.dat");
+    if (mutationLog.loadFailed) return 1;
     
     // Debug: Show startup status
     cout << "=== STARTUP DEBUG INFO ===" << endl;
     cout << "BST root: " << (root == nullptr ? "nullptr" : "exists") << endl;
-    cout << "Sorted products array size: " << sortedProducts.size() << endl;
-    if (!sortedProducts.empty()) {
-        cout << "First product: " << sortedProducts[0].ID << endl;
-        cout << "Last product: " << sortedProducts[sortedProducts.size()-1].ID << endl;
+    cout << "Sorted products array size: " << idView.size() << endl;
+    cout << "Log records replayed: " << replayed << endl;
+    if (!idView.empty()) {
+        cout << "First product: " << formatProductID(columns.id[idView.front()]) << endl;
+        cout << "Last product: " << formatProductID(columns.id[idView.back()]) << endl;
     }
     cout << "==========================\n" << endl;
     pressEnterToContinue();
@@ -129,8 +190,12 @@ int main() {
         }
     } while (choice != 6);
     
-    // Save products to file before exiting
-    saveProductsToFile("products.dat");
+    // Every change is already in the log; only write a snapshot if the log
+    // could not be opened
+    if (mutationLog.file == nullptr && !mutationLog.loadFailed) {
+        saveProductsToFile(catalogFilePath());
+    }
+    closeMutationLog();
     
     return 0;
 }
@@ -172,122 +237,92 @@ void saveMenu() {
         cout << "======== SAVE/LOAD DATA ========\n";
         cout << " 1️⃣  Save Products to File\n";
         cout << " 2️⃣  Load Products from File\n";
-        cout << " 3️⃣  Back to Main Menu\n";
+        cout << " 3️⃣  Export Products to CSV\n";
+        cout << " 4️⃣  Back to Main Menu\n";
         cout << "================================\n";
-        cout << "👉 Enter your choice (1-3): ";
+        cout << "👉 Enter your choice (1-4): ";
         cin >> choice;
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         
         switch(choice) {
             case 1:
-                saveProductsToFile("products.dat");
-                cout << "\n\033[32m✅ Products saved successfully!\033[0m\n";
+                // Folds the log into a fresh snapshot and waits for it
+                if (saveCatalog()) {
+                    cout << "\n\033[32m✅ Products saved successfully!\033[0m\n";
+                } else {
+                    cout << "\n\033[31m❌ Could not save " << catalogFilePath() << ".\033[0m\n";
+                }
                 pressEnterToContinue();
                 break;
             case 2:
-                loadProductsFromFile("products.dat");
-                cout << "\n\033[32m✅ Products loaded successfully!\033[0m\n";
+                openCatalog("products.dat");
+                if (mutationLog.loadFailed) {
+                    cout << "\n\033[31m❌ Could not load " << catalogFilePath()
+                         << ". Changes are not saved until it is restored and loaded.\033[0m\n";
+                } else {
+                    cout << "\n\033[32m✅ Products loaded successfully!\033[0m\n";
+                }
                 pressEnterToContinue();
                 break;
-            case 3:
+            case 3: {
+                string filename;
+                cout << "📤 Export to file (default products.csv): ";
+                getline(cin, filename);
+                if (filename.empty()) filename = "products.csv";
+                if (exportProductsToCSV(filename)) {
+                    cout << "\n\033[32m✅ " << idView.size() << " products exported to " << filename << "\033[0m\n";
+                } else {
+                    cout << "\n\033[31m❌ Could not export to " << filename << ".\033[0m\n";
+                }
+                pressEnterToContinue();
+                break;
+            }
+            case 4:
                 break;
             default:
                 cout << "Invalid choice! Please try again.\n";
         pressEnterToContinue();
                 cin.get();
         }
-    } while (choice != 3);
+    } while (choice != 4);
 }
 
-void saveProductsToFile(const string& filename) {
-    ofstream outFile(filename, ios::binary);
-    if (!outFile) {
-        cerr << "Error: Could not open file for writing: " << filename << endl;
-        return;
+void printImportStats(const ImportStats& stats) {
+    double totalMs = stats.parseMs + stats.insertMs + stats.saveMs;
+    cout << "\n\033[32m✅ Imported " << stats.imported << " of " << stats.rows << " rows\033[0m";
+    if (stats.rejected > 0) {
+        cout << " \033[31m(" << stats.rejected << " rejected)\033[0m";
     }
-    
-    // First, convert BST to vector
-    sortedProducts.clear();
-    toArray(root, sortedProducts);
-    
-    // Write the number of products
-    size_t numProducts = sortedProducts.size();
-    outFile.write(reinterpret_cast<const char*>(&numProducts), sizeof(numProducts));
-    
-    // Write each product
-    for (const auto& product : sortedProducts) {
-        // Write ID
-        size_t idSize = product.ID.size();
-        outFile.write(reinterpret_cast<const char*>(&idSize), sizeof(idSize));
-        outFile.write(product.ID.c_str(), idSize);
-        
-        // Write name
-        size_t nameSize = product.name.size();
-        outFile.write(reinterpret_cast<const char*>(&nameSize), sizeof(nameSize));
-        outFile.write(product.name.c_str(), nameSize);
-        
-        // Write category
-        size_t categorySize = product.category.size();
-        outFile.write(reinterpret_cast<const char*>(&categorySize), sizeof(categorySize));
-        outFile.write(product.category.c_str(), categorySize);
-        
-        // Write price and rating
-        outFile.write(reinterpret_cast<const char*>(&product.price), sizeof(product.price));
-        outFile.write(reinterpret_cast<const char*>(&product.rating), sizeof(product.rating));
+    cout << " using " << stats.threads << (stats.threads == 1 ? " thread" : " threads") << endl;
+    cout << fixed << setprecision(1);
+    cout << "\033[36mParse:\033[0m " << stats.parseMs << " ms | \033[36mIndex:\033[0m " << stats.insertMs
+         << " ms | \033[36mSave:\033[0m " << stats.saveMs << " ms" << endl;
+    cout << "\033[36mThroughput:\033[0m " << setprecision(0) << (totalMs > 0 ? stats.rows * 1000.0 / totalMs : 0.0)
+         << " rows/sec" << endl;
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+    cout << "\033[36mIndexing:\033[0m " << (stats.rebuilt ? "rebuilt the catalog" : "added one at a time")
+         << " (rebuild threshold: " << stats.rebuildRows << " products, 1/" << IMPORT_REBUILD_SHARE
+         << " of the catalog)" << endl;
+    if (stats.imported > 0 && !stats.saved) {
+        cout << "\033[31m⚠️  The imported products were not saved: the change log is not open or could not be written.\033[0m" << endl;
     }
-    
-    outFile.close();
 }
 
-void loadProductsFromFile(const string& filename) {
-    ifstream inFile(filename, ios::binary);
-    if (!inFile) {
-        cerr << "Info: No existing data file found. Starting with empty product list." << endl;
-        return;
-    }
-    
-    // Clear existing BST
-    root = nullptr;
-    sortedProducts.clear();
-    
-    // Read the number of products
-    size_t numProducts;
-    inFile.read(reinterpret_cast<char*>(&numProducts), sizeof(numProducts));
-    
-    // Read each product
-    for (size_t i = 0; i < numProducts; ++i) {
-        Product product;
-        
-        // Read ID
-        size_t idSize;
-        inFile.read(reinterpret_cast<char*>(&idSize), sizeof(idSize));
-        product.ID.resize(idSize);
-        inFile.read(&product.ID[0], idSize);
-        
-        // Read name
-        size_t nameSize;
-        inFile.read(reinterpret_cast<char*>(&nameSize), sizeof(nameSize));
-        product.name.resize(nameSize);
-        inFile.read(&product.name[0], nameSize);
-        
-        // Read category
-        size_t categorySize;
-        inFile.read(reinterpret_cast<char*>(&categorySize), sizeof(categorySize));
-        product.category.resize(categorySize);
-        inFile.read(&product.category[0], categorySize);
-        
-        // Read price and rating
-        inFile.read(reinterpret_cast<char*>(&product.price), sizeof(product.price));
-        inFile.read(reinterpret_cast<char*>(&product.rating), sizeof(product.rating));
-        
-        // Insert into BST
-        root = insertNode(root, product);
+void importProductsMenu() {
+    clearScreen();
+    displayHeader();
+    string filename;
+    cout << "📥 Enter the path of a CSV or JSON lines file: ";
+    getline(cin, filename);
+    if (filename.empty()) return;
+
+    ImportStats stats;
+    if (importProductsFromFile(filename, 0, stats)) {
+        printImportStats(stats);
+    } else {
+        cout << "\n\033[31m❌ Nothing was imported.\033[0m\n";
     }
-    
-    inFile.close();
-    
-    // Update the sorted products vector
-    toArray(root, sortedProducts);
 }
 
 void productManagementMenu() {
@@ -300,17 +335,18 @@ void productManagementMenu() {
         cout << " 2️⃣  Display All Products\n";
         cout << " 3️⃣  Search Product in BST\n";
         cout << " 4️⃣  Check ID Status\n";
-        cout << " 5️⃣  Back to Main Menu\n";
+        cout << " 5️⃣  Update Product\n";
+        cout << " 6️⃣  Remove Product\n";
+        cout << " 7️⃣  Import Products from File\n";
+        cout << " 8️⃣  Back to Main Menu\n";
         cout << "====================================\n";
-        cout << "👉 Enter your choice (1-5): ";
+        cout << "👉 Enter your choice (1-8): ";
         cin >> choice;
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         
         switch(choice) {
             case 1:
-                ::root = addProducts(::root);
-                sortedProducts.clear();
-                toArray(::root, sortedProducts);
+                addProducts();
                 pressEnterToContinue();
                 break;
             case 2:
@@ -318,23 +354,24 @@ void productManagementMenu() {
                 pressEnterToContinue();
                 break;
             case 3: {
-                string id;
+                string input;
                 cout << "🔍 Enter Product ID to search in BST (e.g., PID01): ";
-                cin >> id;
-                id = normalizeID(id);
+                cin >> input;
+                int id = parseProductID(input);
                 cin.ignore(numeric_limits<streamsize>::max(), '\n');
                 Node* foundNode = searchNode(root, id);
                 if (foundNode != nullptr) {
+                    Product product = productAt(foundNode->slot);
                     cout << "\n\033[32m✅ Product Found in BST:\033[0m\n";
                     cout << "-----------------------------------\n";
-                    cout << "\033[36mID:\033[0m " << foundNode->data.ID
-                         << " | \033[36mName:\033[0m " << foundNode->data.name
-                         << " | \033[36mCategory:\033[0m " << foundNode->data.category
-                         << " | \033[36mPrice:\033[0m $" << foundNode->data.price
-                         << " | \033[36mRating:\033[0m " << foundNode->data.rating << "/5" << endl;
+                    cout << "\033[36mID:\033[0m " << formatProductID(product.id)
+                         << " | \033[36mName:\033[0m " << product.name
+                         << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
+                         << " | \033[36mPrice:\033[0m $" << product.price
+                         << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
                     cout << "-----------------------------------\n";
                 } else {
-                    cout << "\n\033[31m❌ Product with ID " << id << " not found in BST.\033[0m\n";
+                    cout << "\n\033[31m❌ Product with ID " << input << " not found in BST.\033[0m\n";
                 }
                 pressEnterToContinue();
                 break;
@@ -345,24 +382,36 @@ void productManagementMenu() {
                 cout << "======== ID STATUS ========\n";
                 if (root == nullptr) {
                     cout << "\033[31m❌ No products in system.\033[0m\n";
-                    cout << "\033[36mNext product will get ID: PID01\033[0m\n";
+                    cout << "\033[36mNext product will get ID: \033[0m" << formatProductID(peekNextProductNumber()) << endl;
                 } else {
                     int currentMaxID = findMaxID(root);
                     cout << "\033[32m✅ Current highest ID: PID\033[0m" << (currentMaxID < 10 ? "0" : "") << currentMaxID << endl;
-                    cout << "\033[36mNext product will get ID: PID\033[0m" << (currentMaxID + 1 < 10 ? "0" : "") << (currentMaxID + 1) << endl;
-                    cout << "\033[36mTotal products: \033[0m" << sortedProducts.size() << endl;
+                    cout << "\033[36mNext product will get ID: \033[0m" << formatProductID(peekNextProductNumber()) << endl;
+                    cout << "\033[36mTotal products: \033[0m" << idView.size() << endl;
                 }
                 pressEnterToContinue();
                 break;
             }
             case 5:
+                editProduct();
+                pressEnterToContinue();
+                break;
+            case 6:
+                deleteProduct();
+                pressEnterToContinue();
+                break;
+            case 7:
+                importProductsMenu();
+                pressEnterToContinue();
+                break;
+            case 8:
                 break;
             default:
                 cout << "Invalid choice! Please try again.\n";
         pressEnterToContinue();
                 
         }
-    } while (choice != 5);
+    } while (choice != 8);
 }
 
 void searchFilterMenu() {
@@ -376,9 +425,11 @@ void searchFilterMenu() {
         cout << " 3️⃣  Filter by Category\n";
         cout << " 4️⃣  Filter by Price Range\n";
         cout << " 5️⃣  Refresh Products Array\n";
-        cout << " 6️⃣  Back to Main Menu\n";
+        cout << " 6️⃣  Filter by Rating Range\n";
+        cout << " 7️⃣  Combined Query\n";
+        cout << " 8️⃣  Back to Main Menu\n";
         cout << "=================================\n";
-        cout << "👉 Enter your choice (1-6): ";
+        cout << "👉 Enter your choice (1-8): ";
         cin >> choice;
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         
@@ -399,21 +450,29 @@ void searchFilterMenu() {
                 pressEnterToContinue();
                 break;
             case 5:
-                sortedProducts.clear();
-                toArray(root, sortedProducts);
+                // The views are kept in sync on every change; refreshing only restores ID order
+                sortByID();
                 cout << "✅ Products array refreshed! Current size: " 
-                     << sortedProducts.size() << endl;
+                     << idView.size() << endl;
                 pressEnterToContinue();
                 cin.get();
                 break;
             case 6:
+                filterByRatingRange();
+                pressEnterToContinue();
+                break;
+            case 7:
+                combinedQuery();
+                pressEnterToContinue();
+                break;
+            case 8:
                 break;
             default:
                 cout << "❌ Invalid choice! Try again.\n";
                 pressEnterToContinue();
                 cin.get();
         }
-    } while (choice != 6);
+    } while (choice != 8);
 }
 
 void sortingMenu() {
@@ -467,8 +526,7 @@ void sortingMenu() {
                 pressEnterToContinue();
                 break;
             case 7:
-                displaySortedList();
-                pressEnterToContinue();
+                browseSortedList();
                 break;
             case 8:
                 break;
@@ -489,9 +547,10 @@ void cartMenu() {
         cout << " 1️⃣  Add Product to Cart\n";
         cout << " 2️⃣  View Cart\n";
         cout << " 3️⃣  Checkout\n";
-        cout << " 4️⃣  Back to Main Menu\n";
+        cout << " 4️⃣  Change Quantity\n";
+        cout << " 5️⃣  Back to Main Menu\n";
         cout << "=================================\n";
-        cout << "👉 Enter your choice (1-4): ";
+        cout << "👉 Enter your choice (1-5): ";
         cin >> choice;
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         
@@ -509,12 +568,16 @@ void cartMenu() {
                 pressEnterToContinue();
                 break;
             case 4:
+                changeCartQuantity();
+                pressEnterToContinue();
+                break;
+            case 5:
                 break;
             default:
                 cout << "\033[31m❌ Invalid choice! Please try again.\033[0m\n";
                 pressEnterToContinue();
         }
-    } while (choice != 4);
+    } while (choice != 5);
 }
 
 void displayAllProducts() {
@@ -529,7 +592,7 @@ void displayAllProducts() {
     // Show current highest ID for reference
     int currentMaxID = findMaxID(root);
     cout << "\033[36mCurrent highest ID: PID\033[0m" << (currentMaxID < 10 ? "0" : "") << currentMaxID << endl;
-    cout << "\033[36mNext product will get ID: PID\033[0m" << (currentMaxID + 1 < 10 ? "0" : "") << (currentMaxID + 1) << endl;
+    cout << "\033[36mNext product will get ID: \033[0m" << formatProductID(peekNextProductNumber()) << endl;
     cout << "\033[36m----------------------------------------\033[0m\n";
     
     inOrderTraversal(root);
@@ -539,43 +602,45 @@ void searchByID() {
     clearScreen();
     displayHeader();
     cout << "🔍 Enter Product ID to search (e.g., PID01): ";
-    string id;
+    string input;
 
-    cin >> id;
+    cin >> input;
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
-    id = normalizeID(id);
+    int id = parseProductID(input);
 
     // Try BST search first
     Node* foundNode = searchNode(root, id);
     if (foundNode != nullptr) {
+        Product product = productAt(foundNode->slot);
         cout << "\n\033[32m✅ Product Found (BST Search):\033[0m\n";
         cout << "-----------------------------------\n";
-        cout << "ID: " << foundNode->data.ID
-             << ", Name: " << foundNode->data.name
-             << ", Category: " << foundNode->data.category
-             << ", Price: $" << foundNode->data.price
-             << ", Rating: " << foundNode->data.rating << "/5" << endl;
+        cout << "ID: " << formatProductID(product.id)
+             << ", Name: " << product.name
+             << ", Category: " << categoryName(product.categoryCode)
+             << ", Price: $" << product.price
+             << ", Rating: " << product.rating << "/5" << endl;
         cout << "-----------------------------------\n";
     } 
     else {
         cout << "\n\033[33m⚠️ Not found in BST, trying array search...\033[0m\n";
-        int index = binarySearchByID(sortedProducts, id);
+        int index = binarySearchByID(idView, id);
         if (index != -1) {
+            Product product = productAt(idView[index]);
             cout << "\n\033[32m✅ Product Found (Array Search):\033[0m\n";
             cout << "-----------------------------------\n";
-            cout << "ID: " << sortedProducts[index].ID
-                 << ", Name: " << sortedProducts[index].name
-                 << ", Category: " << sortedProducts[index].category
-                 << ", Price: $" << sortedProducts[index].price
-                 << ", Rating: " << sortedProducts[index].rating << "/5" << endl;
+            cout << "ID: " << formatProductID(product.id)
+                 << ", Name: " << product.name
+                 << ", Category: " << categoryName(product.categoryCode)
+                 << ", Price: $" << product.price
+                 << ", Rating: " << product.rating << "/5" << endl;
             cout << "-----------------------------------\n";
         } else {
-            cout << "\n\033[31m❌ Product with ID " << id << " not found.\033[0m\n";
-            if (!sortedProducts.empty()) {
+            cout << "\n\033[31m❌ Product with ID " << input << " not found.\033[0m\n";
+            if (!idView.empty()) {
                 cout << "Available product IDs: ";
-                for (const auto& p : sortedProducts) {
-                    cout << p.ID << " ";
+                for (int slot : idView) {
+                    cout << formatProductID(columns.id[slot]) << " ";
                 }
                 cout << endl;
             }
@@ -584,35 +649,6 @@ void searchByID() {
     pressEnterToContinue();
 }
 
-string normalizeID(string id) {
-
-    if (id.substr(0, 3) != "PID") {
-        id = "PID" + id.substr(3);
-    }
-    return id;
-}
-
-int binarySearchByID(const vector<Product>& arr, const string& targetID) {
-    int low = 0;
-    int high = arr.size() - 1;
-
-    while (low <= high) {
-        int mid = (low + high) / 2;
-
-        if (arr[mid].ID == targetID) {
-            return mid;
-        } 
-        else if (arr[mid].ID < targetID) {
-            low = mid + 1;
-        } 
-        else {
-            high = mid - 1;
-        }
-    }
-
-    return -1;
-}
-
 void searchByName() {
     clearScreen();
     displayHeader();
@@ -620,24 +656,42 @@ void searchByName() {
     cout << "🔍 Enter product name to search: ";
     getline(cin, name);
     
-    bool found = false;
-    for (const auto& product : sortedProducts) {
-        if (product.name.find(name) != string::npos) {
-            if (!found) {
-                cout << "\n\033[32m✅ Search Results:\033[0m\n";
-                cout << "-----------------------------------\n";
-                found = true;
-            }
-            cout << "\033[36mID:\033[0m " << product.ID
-                 << " | \033[36mName:\033[0m " << product.name
-                 << " | \033[36mCategory:\033[0m " << product.category
-                 << " | \033[36mPrice:\033[0m $" << product.price
-                 << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
-        }
+    // Substring match first (the original semantics, now case-insensitive),
+    // then words in any order, then typo-tolerant matching
+    vector<int> matches = substringSearchNames(name);
+    if (!matches.empty()) {
+        cout << "\n\033[32m✅ Search Results:\033[0m\n";
+        printNameMatches(matches);
+        return;
     }
     
-    if (!found) {
-        cout << "\n\033[31m❌ No products found with name containing: \033[0m" << name << endl;
+    matches = searchNameIndex(name);
+    if (!matches.empty()) {
+        cout << "\n\033[32m✅ Search Results (all words):\033[0m\n";
+        printNameMatches(matches);
+        return;
+    }
+    
+    matches = fuzzySearchNames(name, 2);
+    if (!matches.empty()) {
+        cout << "\n\033[33m🔎 No exact matches. Did you mean:\033[0m\n";
+        printNameMatches(matches);
+        return;
+    }
+    
+    cout << "\n\033[31m❌ No products found with name containing: \033[0m" << name << endl;
+    cout << "-----------------------------------\n";
+}
+
+void printNameMatches(const vector<int>& ids) {
+    cout << "-----------------------------------\n";
+    for (int id : ids) {
+        Product product = productAt(searchNode(root, id)->slot);
+        cout << "\033[36mID:\033[0m " << formatProductID(product.id)
+             << " | \033[36mName:\033[0m " << product.name
+             << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
+             << " | \033[36mPrice:\033[0m $" << product.price
+             << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
     }
     cout << "-----------------------------------\n";
 }
@@ -649,22 +703,19 @@ void filterByCategory() {
     cout << "🏷️ Enter category to filter: ";
     getline(cin, category);
     
-    bool found = false;
-    for (const auto& product : sortedProducts) {
-        if (product.category == category) {
-            if (!found) {
-                cout << "\n\033[32m✅ Products in category '\033[0m" << category << "\033[32m':\033[0m\n";
-                cout << "-----------------------------------\n";
-                found = true;
-            }
-            cout << "\033[36mID:\033[0m " << product.ID
+    // One dictionary lookup, then only this category's products are visited
+    int code = findCategory(category);
+    if (code >= 0 && !categoryPostings[code].empty()) {
+        cout << "\n\033[32m✅ Products in category '\033[0m" << category << "\033[32m':\033[0m\n";
+        cout << "-----------------------------------\n";
+        for (int slot : categoryPostings[code]) {
+            Product product = productAt(slot);
+            cout << "\033[36mID:\033[0m " << formatProductID(product.id)
                  << " | \033[36mName:\033[0m " << product.name
                  << " | \033[36mPrice:\033[0m $" << product.price
                  << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
         }
-    }
-    
-    if (!found) {
+    } else {
         cout << "\n\033[31m❌ No products found in category: \033[0m" << category << endl;
     }
     cout << "-----------------------------------\n";
@@ -684,139 +735,291 @@ void filterByPriceRange() {
         return;
     }
     
-    bool found = false;
-    for (const auto& product : sortedProducts) {
-        if (product.price >= minPrice && product.price <= maxPrice) {
-            if (!found) {
-                cout << "\n\033[32m✅ Products in price range \033[0m$" << minPrice << " - $" << maxPrice << "\033[32m:\033[0m\n";
-                cout << "-----------------------------------\n";
-                found = true;
-            }
-            cout << "\033[36mID:\033[0m " << product.ID
+    // Matches form one contiguous run of the price view, cheapest first
+    pair<int, int> range = viewRange(SORT_BY_PRICE, minPrice, maxPrice);
+    const vector<int>& view = sortedViews[SORT_BY_PRICE];
+    
+    if (range.first == range.second) {
+        cout << "\n\033[31m❌ No products found in price range \033[0m$" << minPrice << " - $" << maxPrice << endl;
+    } else {
+        cout << "\n\033[32m✅ Products in price range \033[0m$" << minPrice << " - $" << maxPrice << "\033[32m:\033[0m\n";
+        cout << "-----------------------------------\n";
+        for (int i = range.first; i < range.second; ++i) {
+            Product product = productAt(view[i]);
+            cout << "\033[36mID:\033[0m " << formatProductID(product.id)
                  << " | \033[36mName:\033[0m " << product.name
-                 << " | \033[36mCategory:\033[0m " << product.category
+                 << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
                  << " | \033[36mPrice:\033[0m $" << product.price
                  << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
         }
     }
+    cout << "-----------------------------------\n";
+}
+
+void filterByRatingRange() {
+    clearScreen();
+    displayHeader();
+    float minRating, maxRating;
+    cout << "⭐ Enter minimum rating (1-5): ";
+    cin >> minRating;
+    cout << "⭐ Enter maximum rating (1-5): ";
+    cin >> maxRating;
     
-    if (!found) {
-        cout << "\n\033[31m❌ No products found in price range \033[0m$" << minPrice << " - $" << maxPrice << endl;
+    if (minRating > maxRating) {
+        cout << "\n\033[31m❌ Invalid range! Minimum rating cannot be greater than maximum rating.\033[0m\n";
+        return;
+    }
+    
+    pair<int, int> range = viewRange(SORT_BY_RATING, minRating, maxRating);
+    const vector<int>& view = sortedViews[SORT_BY_RATING];
+    
+    if (range.first == range.second) {
+        cout << "\n\033[31m❌ No products found with rating \033[0m" << minRating << " - " << maxRating << endl;
+    } else {
+        cout << "\n\033[32m✅ Products rated \033[0m" << minRating << " - " << maxRating << "\033[32m:\033[0m\n";
+        cout << "-----------------------------------\n";
+        for (int i = range.first; i < range.second; ++i) {
+            Product product = productAt(view[i]);
+            cout << "\033[36mID:\033[0m " << formatProductID(product.id)
+                 << " | \033[36mName:\033[0m " << product.name
+                 << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
+                 << " | \033[36mPrice:\033[0m $" << product.price
+                 << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
+        }
+    }
+    cout << "-----------------------------------\n";
+}
+
+void combinedQuery() {
+    clearScreen();
+    displayHeader();
+    ProductQuery query;
+    string input;
+    cout << "Leave a field empty to skip it.\n";
+
+    cout << "🔍 Name contains: ";
+    getline(cin, query.nameContains);
+    cout << "🏷️ Category: ";
+    getline(cin, query.category);
+
+    cout << "💰 Price range (min max): $";
+    getline(cin, input);
+    if (!input.empty()) {
+        query.hasPriceRange = sscanf(input.c_str(), "%f %f", &query.minPrice, &query.maxPrice) == 2;
+        if (!query.hasPriceRange) cout << "\033[33m⚠️ Price range ignored (expected two numbers).\033[0m\n";
+    }
+
+    cout << "⭐ Rating range (min max): ";
+    getline(cin, input);
+    if (!input.empty()) {
+        query.hasRatingRange = sscanf(input.c_str(), "%f %f", &query.minRating, &query.maxRating) == 2;
+        if (!query.hasRatingRange) cout << "\033[33m⚠️ Rating range ignored (expected two numbers).\033[0m\n";
+    }
+
+    cout << "↕️ Sort by (1 ID, 2 Price, 3 Rating, 4 Name; add 'd' for descending, e.g. 2d): ";
+    getline(cin, input);
+    if (!input.empty()) {
+        if (input[0] == '2') query.sortKey = SORT_BY_PRICE;
+        else if (input[0] == '3') query.sortKey = SORT_BY_RATING;
+        else if (input[0] == '4') query.sortKey = SORT_BY_NAME;
+        query.ascending = input.find_first_of("dD") == string::npos;
+    }
+
+    cout << "📄 Show at most how many results: ";
+    getline(cin, input);
+    if (!input.empty()) {
+        int limit = atoi(input.c_str());
+        if (limit > 0) query.limit = limit;
+    }
+
+    static const char* sourceNames[] = {"all products", "category", "price range", "rating range", "name"};
+    vector<PredicateEstimate> plan = estimateSelectivity(query);
+    if (!plan.empty()) {
+        cout << "\n\033[36m📋 Plan:\033[0m";
+        for (size_t i = 0; i < plan.size(); ++i) {
+            cout << (i == 0 ? " start from " : ", then ") << sourceNames[plan[i].source]
+                 << " (~" << plan[i].estimate << ")";
+        }
+        cout << endl;
+        if (plan[0].estimate > 0 && prefersAttributeScan(query, plan)) {
+            cout << "\033[36m⚡ Attribute filters run as one " << activeFilterKernels().name
+                 << " scan of the columns\033[0m" << endl;
+        }
+    }
+
+    vector<int> result = runQuery(query);
+    if (result.empty()) {
+        cout << "\n\033[31m❌ No products match all conditions.\033[0m\n";
+    } else {
+        cout << "\n\033[32m✅ Matching products (" << result.size()
+             << (query.limit > 0 ? ", first page" : "") << "):\033[0m\n";
+        cout << "-----------------------------------\n";
+        for (int slot : result) {
+            Product product = productAt(slot);
+            cout << "\033[36mID:\033[0m " << formatProductID(product.id)
+                 << " | \033[36mName:\033[0m " << product.name
+                 << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
+                 << " | \033[36mPrice:\033[0m $" << product.price
+                 << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
+        }
     }
     cout << "-----------------------------------\n";
 }
 
+// The sort functions only select which view displaySortedList reads; the views
+// themselves are always sorted, so no products are moved or copied here.
 void sortByPrice(bool ascending) {
-    if (sortedProducts.empty()) {
+    if (idView.empty()) {
         cout << "No products to sort.\n";
         return;
     }
     
-    if (ascending) {
-        sort(sortedProducts.begin(), sortedProducts.end(), 
-            [](const Product& a, const Product& b) { return a.price < b.price; });
-    } else {
-        sort(sortedProducts.begin(), sortedProducts.end(), 
-            [](const Product& a, const Product& b) { return a.price > b.price; });
-    }
+    displayKey = SORT_BY_PRICE;
+    displayAscending = ascending;
 }
 
 void sortByRating(bool ascending) {
-    if (sortedProducts.empty()) {
+    if (idView.empty()) {
         cout << "No products to sort.\n";
         return;
     }
     
-    if (ascending) {
-        sort(sortedProducts.begin(), sortedProducts.end(), 
-            [](const Product& a, const Product& b) { return a.rating < b.rating; });
-    } else {
-        sort(sortedProducts.begin(), sortedProducts.end(), 
-            [](const Product& a, const Product& b) { return a.rating > b.rating; });
-    }
+    displayKey = SORT_BY_RATING;
+    displayAscending = ascending;
 }
 
 void sortByName(bool ascending) {
-    if (sortedProducts.empty()) {
+    if (idView.empty()) {
         cout << "No products to sort.\n";
         return;
     }
     
-    if (ascending) {
-        sort(sortedProducts.begin(), sortedProducts.end(), 
-            [](const Product& a, const Product& b) { return a.name < b.name; });
-    } else {
-        sort(sortedProducts.begin(), sortedProducts.end(), 
-            [](const Product& a, const Product& b) { return a.name > b.name; });
-    }
+    displayKey = SORT_BY_NAME;
+    displayAscending = ascending;
+}
+
+void sortByID() {
+    displayKey = SORT_BY_ID;
+    displayAscending = true;
 }
 
 void displaySortedList() {
     clearScreen();
     displayHeader();
-    if (sortedProducts.empty()) {
+    const vector<int>& view = sortedViews[displayKey];
+    if (view.empty()) {
         cout << "\n\033[31m❌ No products to display.\033[0m\n";
         return;
     }
     
     cout << "\n\033[32m📋 SORTED PRODUCT LIST:\033[0m\n";
     cout << "==========================================\n";
-    for (const auto& product : sortedProducts) {
-        cout << "\033[36mID:\033[0m " << product.ID
+    for (size_t i = 0; i < view.size(); ++i) {
+        Product product = productAt(displayAscending ? view[i] : view[view.size() - 1 - i]);
+        cout << "\033[36mID:\033[0m " << formatProductID(product.id)
+             << " | \033[36mName:\033[0m " << product.name
+             << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
+             << " | \033[36mPrice:\033[0m $" << product.price
+             << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
+    }
+    cout << "==========================================\n";
+}
+
+// Prints one page of the selected sort order; returns false past the last page
+bool displaySortedPage(size_t page) {
+    size_t total = idView.size();
+    size_t pageCount = (total + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (page >= pageCount) return false;
+
+    cout << "\n\033[32m📋 SORTED PRODUCT LIST\033[0m (page " << page + 1 << " of " << pageCount
+         << ", " << total << " products):\n";
+    cout << "==========================================\n";
+    for (int slot : sortedPage(displayKey, displayAscending, page * PAGE_SIZE, PAGE_SIZE)) {
+        Product product = productAt(slot);
+        cout << "\033[36mID:\033[0m " << formatProductID(product.id)
              << " | \033[36mName:\033[0m " << product.name
-             << " | \033[36mCategory:\033[0m " << product.category
+             << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
              << " | \033[36mPrice:\033[0m $" << product.price
              << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
     }
     cout << "==========================================\n";
+    return true;
+}
+
+void browseSortedList() {
+    if (idView.empty()) {
+        clearScreen();
+        displayHeader();
+        cout << "\n\033[31m❌ No products to display.\033[0m\n";
+        pressEnterToContinue();
+        return;
+    }
+
+    size_t page = 0;
+    string input;
+    while (true) {
+        clearScreen();
+        displayHeader();
+        displaySortedPage(page);
+        cout << "👉 [n] next page, [p] previous page, [q] back: ";
+        if (!getline(cin, input) || input.empty() || tolower(input[0]) == 'q') break;
+
+        char command = tolower(input[0]);
+        if (command == 'n' && (page + 1) * PAGE_SIZE < idView.size()) page++;
+        else if (command == 'p' && page > 0) page--;
+    }
 }
 
 void addProductToCart() {
     clearScreen();
     displayHeader();
-    if (sortedProducts.empty()) {
+    if (idView.empty()) {
         cout << "No products available to add to cart.\n";
         return;
     }
     
     displaySortedList();
-    string productID;
-    cout << "\nEnter Product ID to add to cart: ";
-    cin >> productID;
+    string input, rest;
+    cout << "\nEnter Product ID to add to cart (optionally followed by a quantity, e.g. PID02 5): ";
+    cin >> input;
+    getline(cin, rest);
+    int quantity = rest.find_first_not_of(" \t\r") == string::npos ? 1 : atoi(rest.c_str());
     
-    validateCart(productID);
+    validateCart(parseProductID(input), quantity);
 }
 
 void viewCart() {
     clearScreen();
     displayHeader();
-    if (cartHead == nullptr) {
+    if (cart.lines.empty()) {
         cout << "Cart is empty.\n";
         return;
     }
     
     cout << "🛒 YOUR SHOPPING CART 🛒\n";
-    float total = 0;
-    CartNode* temp = cartHead;
     int itemCount = 1;
     
-    while (temp != nullptr) {
-        cout << itemCount << ". ID: " << temp->data.ID
-             << ", Name: " << temp->data.name
-             << ", Price: $" << temp->data.price << endl;
-        total += temp->data.price;
-        temp = temp->next;
+    for (const CartLine& line : cart.lines) {
+        float price = line.price;
+        cout << itemCount << ". ID: " << formatProductID(line.productID) << ", Name: ";
+        cout.write(columnName(line.slot), columns.name[line.slot].length);
+        cout << ", Price: $" << price;
+        if (line.quantity > 1) {
+            cout << " x " << line.quantity << " = $" << price * line.quantity;
+        }
+        cout << endl;
         itemCount++;
     }
     
     cout << "----------------------------\n";
-    cout << "Total: $" << fixed << setprecision(2) << total << endl;
+    cout << "Items: " << cart.itemCount << endl;
+    cout << "Total: $" << fixed << setprecision(2) << cart.total << endl;
 }
 
 void checkout() {
     clearScreen();
     displayHeader();
-    if (cartHead == nullptr) {
+    if (cart.lines.empty()) {
         cout << "Cart is empty. Nothing to checkout.\n";
         return;
     }
@@ -824,77 +1027,72 @@ void checkout() {
     cout << "💳 CHECKOUT 💳\n";
     cout << "==============================\n";
     
-    float total = 0;
-    CartNode* temp = cartHead;
     int itemCount = 1;
     
-    while (temp != nullptr) {
-        cout << itemCount << ". " << temp->data.name 
-             << " - $" << temp->data.price << endl;
-        total += temp->data.price;
-        temp = temp->next;
+    for (const CartLine& line : cart.lines) {
+        cout << itemCount << ". ";
+        cout.write(columnName(line.slot), columns.name[line.slot].length);
+        if (line.quantity > 1) cout << " x " << line.quantity;
+        cout << " - $" << line.price * line.quantity << endl;
         itemCount++;
     }
     
     cout << "==============================\n";
-    cout << "TOTAL: $" << fixed << setprecision(2) << total << endl;
+    cout << "TOTAL: $" << fixed << setprecision(2) << cart.total << endl;
     cout << "Thank you for your purchase!\n";
     
-    // Clear cart
-    while (cartHead != nullptr) {
-        CartNode* del = cartHead;
-        cartHead = cartHead->next;
-        delete del;
-    }
-}
-
-CartNode* createCartNode(Product p) {
-    CartNode* newNode = new CartNode();
-    newNode->data = p;
-    newNode->next = nullptr;
-    return newNode;
+    clearCart();
 }
 
-void addToCart(Product product) {
-    if (cartHead == nullptr) {
-        cartHead = createCartNode(product);
-        cout << "Added To Cart Successfully\n";
+void changeCartQuantity() {
+    clearScreen();
+    displayHeader();
+    if (cart.lines.empty()) {
+        cout << "Cart is empty.\n";
         return;
     }
 
-    CartNode* temp = cartHead;
-    while (temp->next != nullptr) {
-        temp = temp->next;
-    }
-    temp->next = createCartNode(product);
-    cout << "Added To Cart Successfully\n";
-}
-
-bool isInCart(CartNode* head, const string& productID) {
-    CartNode* current = head;
-    while (current != nullptr) {
-        if (current->data.ID == productID) {
-            return true;
-        }
-        current = current->next;
+    string input;
+    cout << "Enter Product ID and new quantity (0 removes it), e.g. PID02 3: ";
+    getline(cin, input);
+    size_t split = input.find(' ');
+    int productID = parseProductID(input.substr(0, split));
+    int quantity = split == string::npos ? -1 : atoi(input.c_str() + split);
+
+    if (!isInCart(productID)) {
+        cout << "This product is not in the cart.\n";
+    } else if (!setCartQuantity(productID, quantity)) {
+        cout << "Invalid quantity (0 to " << MAX_CART_QUANTITY << ").\n";
+    } else if (quantity == 0) {
+        cout << "Removed from cart.\n";
+    } else {
+        cout << "Quantity updated.\n";
     }
-    return false;
 }
 
-void validateCart(string productID) {
-    int productLocation = binarySearchByID(sortedProducts, productID);
+void validateCart(int productID, int quantity) {
+    int productLocation = binarySearchByID(idView, productID);
 
     if (productLocation == -1) {
         cout << "Invalid Product ID\n";
         return;
     }
 
-    if (isInCart(cartHead, productID)) {
-        cout << "This product is already in the cart.\n";
+    if (quantity <= 0 || quantity > MAX_CART_QUANTITY) {
+        cout << "Invalid quantity (1 to " << MAX_CART_QUANTITY << ").\n";
         return;
     }
 
-    addToCart(sortedProducts[productLocation]);
+    bool merged = isInCart(productID);
+    if (!addToCart(idView[productLocation], quantity)) {
+        cout << "This product is already in the cart " << MAX_CART_QUANTITY << " times.\n";
+        return;
+    }
+    if (merged) {
+        cout << "Quantity updated to " << cart.lines[findCartLine(cart, productID)].quantity << "\n";
+    } else {
+        cout << "Added To Cart Successfully\n";
+    }
 }
 
 void displayThankYou() {
@@ -907,110 +1105,63 @@ void displayThankYou() {
     cout << "=============================================\n\n";
 }
 
-// Function definitions
-int generateProductNumber(Node* root) {
-    // Find the highest existing ID number and continue from there
-    int maxID = 0;
-    
-    // Traverse the BST to find the highest ID
-    if (root != nullptr) {
-        // Use a helper function to find max ID
-        maxID = findMaxID(root);
-    }
-    
-    // If no products exist, start from 1, otherwise continue from max + 1
-    return maxID + 1;
-}
-
-int findMaxID(Node* root) {
-    if (root == nullptr) return 0;
-    
-    int currentID = extractIDNumber(root->data.ID);
-    int leftMax = findMaxID(root->left);
-    int rightMax = findMaxID(root->right);
-    
-    return max({currentID, leftMax, rightMax});
-}
-
-string formatProductID(int number) {
-    return "PID" + (number < 10 ? "0" + to_string(number) : to_string(number));
-}
-
-int extractIDNumber(const string& id) {
-    return stoi(id.substr(3));
-}
-
-Node* createNode(Product p) {
-    Node* newNode = new Node();
-    newNode->data = p;
-    newNode->left = nullptr;
-    newNode->right = nullptr;
-    return newNode;
-}
-
-Node* insertNode(Node* root, Product p) {
-    if (root == nullptr) {
-        return createNode(p);
-    }
-    int newIDNum = extractIDNumber(p.ID);
-    int rootIDNum = extractIDNumber(root->data.ID);
-
-    if (newIDNum < rootIDNum) {
-        root->left = insertNode(root->left, p);
-    } else if (newIDNum > rootIDNum) {
-        root->right = insertNode(root->right, p);
-    } else {
-        cout << "Product with ID " << p.ID << " already exists.\n";
+void inOrderTraversal(Node* root) {
+    Node* stack[MAX_TREE_HEIGHT];
+    int top = 0;
+    Node* current = root;
+
+    while (current != nullptr || top > 0) {
+        while (current != nullptr) {
+            stack[top++] = current;
+            current = current->left;
+        }
+        current = stack[--top];
+        Product product = productAt(current->slot);
+        cout << "\033[36mID:\033[0m " << formatProductID(product.id)
+             << " | \033[36mName:\033[0m " << product.name
+             << " | \033[36mCategory:\033[0m " << categoryName(product.categoryCode)
+             << " | \033[36mPrice:\033[0m $" << product.price
+             << " | \033[36mRating:\033[0m " << product.rating << "/5" << endl;
+        current = current->right;
     }
-    return root;
 }
 
-Node* searchNode(Node* root, const string& targetID) {
-    if (root == nullptr || root->data.ID == targetID) {
-        return root;
-    }
-    
-    int targetIDNum = extractIDNumber(targetID);
-    int rootIDNum = extractIDNumber(root->data.ID);
-    
-    if (targetIDNum < rootIDNum) {
-        return searchNode(root->left, targetID);
-    } else {
-        return searchNode(root->right, targetID);
-    }
-}
+// Prompts for name, category, price and rating until each one is valid
+void readProductDetails(Product& p) {
+    do {
+        cout << "Name: ";
+        getline(cin, p.name);
+        if (!isValidNameOrCategory(p.name))
+            cout << "Invalid name! Only letters and spaces are allowed.\n";
+    } while (!isValidNameOrCategory(p.name));
 
-void inOrderTraversal(Node* root) {
-    if (root != nullptr) {
-        inOrderTraversal(root->left);
-        cout << "\033[36mID:\033[0m " << root->data.ID
-             << " | \033[36mName:\033[0m " << root->data.name
-             << " | \033[36mCategory:\033[0m " << root->data.category
-             << " | \033[36mPrice:\033[0m $" << root->data.price
-             << " | \033[36mRating:\033[0m " << root->data.rating << "/5" << endl;
-        inOrderTraversal(root->right);
+    string category;
+    do {
+        cout << "Category: ";
+        getline(cin, category);
+        if (!isValidNameOrCategory(category))
+            cout << "Invalid category! Only letters and spaces are allowed.\n";
+    } while (!isValidNameOrCategory(category));
+    p.categoryCode = internCategory(category);
+
+    cout << "Price: $";
+    while (!(cin >> p.price) || p.price < 0) {
+        cout << "Invalid price! Enter a non-negative number: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
     }
-}
 
-void toArray(Node* root, vector<Product>& arr) {
-    if (root != nullptr) {
-        toArray(root->left, arr);
-        arr.push_back(root->data);
-        toArray(root->right, arr);
+    cout << "Rating (1-5): ";
+    while (!(cin >> p.rating) || p.rating < 1.0 || p.rating > 5.0) {
+        cout << "Invalid rating! Enter a number between 1 and 5: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
     }
-}
 
-bool isValidNameOrCategory(const string& str) {
-    if (str.empty()) return false;
-    bool hasAlpha = false;
-    for (char c : str) {
-        if (isalpha(c)) hasAlpha = true;
-        else if (!isspace(c)) return false;
-    }
-    return hasAlpha;
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
 }
 
-Node* addProducts(Node* root) {
+void addProducts() {
     char choice;
 
     do {
@@ -1019,41 +1170,13 @@ Node* addProducts(Node* root) {
         Product p;
         cout << "\nEnter product details:\n";
 
-        int autoID = generateProductNumber(root);
-        p.ID = formatProductID(autoID);
-        cout << "Assigned ID: " << p.ID << endl;
-
-        do {
-            cout << "Name: ";
-            getline(cin, p.name);
-            if (!isValidNameOrCategory(p.name))
-                cout << "Invalid name! Only letters and spaces are allowed.\n";
-        } while (!isValidNameOrCategory(p.name));
-
-        do {
-            cout << "Category: ";
-            getline(cin, p.category);
-            if (!isValidNameOrCategory(p.category))
-                cout << "Invalid category! Only letters and spaces are allowed.\n";
-        } while (!isValidNameOrCategory(p.category));
-
-        cout << "Price: $";
-        while (!(cin >> p.price) || p.price < 0) {
-            cout << "Invalid price! Enter a non-negative number: ";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        }
+        int autoID = generateProductNumber();
+        p.id = autoID;
+        cout << "Assigned ID: " << formatProductID(p.id) << endl;
 
-        cout << "Rating (1-5): ";
-        while (!(cin >> p.rating) || p.rating < 1.0 || p.rating > 5.0) {
-            cout << "Invalid rating! Enter a number between 1 and 5: ";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        }
-
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-
-        root = insertNode(root, p);
+        readProductDetails(p);
+        addProduct(p);
+        syncMutationLog();
 
         cout << "\nDo you want to add another product? (y/n): ";
         string input;
@@ -1062,11 +1185,61 @@ Node* addProducts(Node* root) {
         else choice = tolower(input[0]);
 
     } while (choice == 'y');
+}
 
-    return root;
+void editProduct() {
+    clearScreen();
+    displayHeader();
+    string input;
+    cout << "✏️ Enter Product ID to update (e.g., PID01): ";
+    cin >> input;
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    Node* foundNode = searchNode(root, parseProductID(input));
+    if (foundNode == nullptr) {
+        cout << "\n\033[31m❌ Product with ID " << input << " not found.\033[0m\n";
+        return;
+    }
+
+    Product p = productAt(foundNode->slot);
+    cout << "Current: " << p.name << " | " << categoryName(p.categoryCode)
+         << " | $" << p.price << " | " << p.rating << "/5\n";
+    cout << "\nEnter new product details:\n";
+    readProductDetails(p);
+    updateProduct(p);
+    syncMutationLog();
+    cout << "\n\033[32m✅ Product " << formatProductID(p.id) << " updated.\033[0m\n";
 }
+
+void deleteProduct() {
+    clearScreen();
+    displayHeader();
+    string input;
+    cout << "🗑️ Enter Product ID to remove (e.g., PID01): ";
+    cin >> input;
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    if (removeProduct(parseProductID(input))) {
+        syncMutationLog();
+        cout << "\n\033[32m✅ Product " << input << " removed.\033[0m\n";
+    } else {
+        cout << "\n\033[31m❌ Product with ID " << input << " not found.\033[0m\n";
+    }
+}
+
 void pressEnterToContinue() {
     cout << "\n\033[36mPress Enter to continue...\033[0m";
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     
-}
\ No newline at end of file
+}
+
+void printLoadStats(const LoadStats& stats) {
+    cout << "Load: " << stats.connections << " connections, pipeline depth " << stats.depth << ", " << fixed
+         << setprecision(1) << stats.elapsedMs / 1000.0 << " s" << endl;
+    cout << "Requests: " << stats.requests << " (" << stats.failed << " failed), " << setprecision(0)
+         << stats.requests / stats.elapsedMs * 1000.0 << " requests/s" << endl;
+    cout << "Latency: p50 " << setprecision(3) << loadPercentile(stats, 50) / 1000.0 << " ms | p90 "
+         << loadPercentile(stats, 90) / 1000.0 << " ms | p99 " << loadPercentile(stats, 99) / 1000.0
+         << " ms | max " << loadPercentile(stats, 100) / 1000.0 << " ms" << endl;
+    cout.unsetf(ios::fixed);
+}
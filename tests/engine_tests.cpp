@@ -0,0 +1,106 @@
+// Regression tests for the catalog engine, run by ctest. Each test builds the
+// catalog it needs through the engine API; checks print what failed and the
+// process exits non-zero if any did.
+//
+//   ./engine_tests
+#include "ecommerce.h"
+#include "catalog_generator.h"
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+
+const char TEST_CATALOG_FILE[] = "engine_tests_catalog.dat";
+
+int failures = 0;
+
+void check(bool condition, const string& what) {
+    if (!condition) {
+        cerr << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+string readFile(const string& path) {
+    ifstream file(path, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+void writeFile(const string& path, const string& bytes) {
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(bytes.data(), bytes.size());
+}
+
+void removeCatalogFiles(const string& path) {
+    remove(path.c_str());
+    remove((path + ".wal").c_str());
+    remove((path + ".wal.old").c_str());
+}
+
+// A snapshot that fails validation must survive the session that failed to
+// load it: no log is opened, and Save and compaction leave the file as it is
+void testSaveAfterFailedLoad() {
+    string path = TEST_CATALOG_FILE;
+    removeCatalogFiles(path);
+    loadGeneratedCatalog(defaultCatalogSpec(1000, 1));
+    check(saveProductsToFile(path), "write the test catalog");
+    string original = readFile(path);
+
+    // A version this build does not know
+    string damaged = original;
+    uint32_t version = CATALOG_VERSION + 1;
+    damaged.replace(offsetof(CatalogHeader, version), sizeof(version),
+                    reinterpret_cast<const char*>(&version), sizeof(version));
+    writeFile(path, damaged);
+
+    openCatalog(path);
+    check(mutationLog.loadFailed, "a newer-version snapshot is rejected");
+    check(mutationLog.file == nullptr, "no log is opened after a failed load");
+    check(!saveCatalog(), "save refuses after a failed load");
+    check(!compactCatalog(true), "compaction refuses after a failed load");
+    closeMutationLog();
+    check(readFile(path) == damaged, "the rejected snapshot is unchanged");
+    check(!fileExists(path + ".wal"), "no log is created beside the rejected snapshot");
+
+    // Once the file is restored, the next load clears the failure
+    writeFile(path, original);
+    openCatalog(path);
+    check(!mutationLog.loadFailed && idView.size() == 1000, "the restored snapshot loads");
+    check(saveCatalog(), "save works again after a successful load");
+    closeMutationLog();
+    removeCatalogFiles(path);
+}
+
+// A query longer than three characters that reduces to one trigram must
+// still be checked against each name
+void testRepeatedCharacterSearch() {
+    vector<Product> products = {
+        {1, "Zaaa Toy", internCategory("Toys"), 5.0f, 4.0f},
+        {2, "Baaab", internCategory("Toys"), 6.0f, 4.0f},
+        {3, "Saaaa", internCategory("Toys"), 7.0f, 4.0f},
+    };
+    bulkLoadProducts(products);
+
+    check(substringSearchNames("aaaa") == vector<int>{3}, "\"aaaa\" matches only Saaaa");
+    check(substringSearchNames("AAAA") == vector<int>{3}, "the repeated-character search ignores case");
+    check(substringSearchNames("aaa") == vector<int>({1, 2, 3}), "\"aaa\" matches all three names");
+
+    const char* match = nullptr;
+    check(cascadeNameSearch(liveNameSource(), "aaaa", match) == vector<int>{3} && string(match) == "substring",
+          "the name command finds only Saaaa");
+}
+
+int main() {
+    testSaveAfterFailedLoad();
+    testRepeatedCharacterSearch();
+
+    if (failures > 0) {
+        cerr << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "All engine tests passed" << endl;
+    return 0;
+}